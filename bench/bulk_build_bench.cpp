@@ -0,0 +1,64 @@
+/* Bulk construction of HashMap: inserts one by one against the range constructor.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. bulk_build_bench.cpp -o bulk_build_bench
+   Usage: ./bulk_build_bench [num_of_entries = 20000000]
+   Keys are random, a few percent of them repeat. The range constructor presizes the table once
+   and, with more than one thread, fills disjoint ranges of cells from all threads of ThreadPool::instance(). */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../hashtable.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+template<class Build>
+double seconds_of(Build build) {
+    auto start = std::chrono::steady_clock::now();
+    build();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+
+    std::mt19937_64 rng(1);
+    std::vector<std::pair<uint64_t, uint64_t>> entries(num_of_entries);
+    for (size_t i = 0; i < num_of_entries; ++i) {
+        entries[i] = {rng() % (num_of_entries * 20), i};
+    }
+
+    size_t one_by_one_size = 0;
+    double one_by_one = seconds_of([&] {
+        Map map;
+        for (const auto& entry : entries) {
+            map.insert(entry);
+        }
+        one_by_one_size = map.size();
+    });
+    size_t reserved_size = 0;
+    double reserved = seconds_of([&] {
+        Map map;
+        map.reserve(entries.size());
+        for (const auto& entry : entries) {
+            map.insert(entry);
+        }
+        reserved_size = map.size();
+    });
+    size_t range_size = 0;
+    double range = seconds_of([&] {
+        Map map(entries.begin(), entries.end());
+        range_size = map.size();
+    });
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%-22s %10s %12s\n", "build", "seconds", "entries");
+    std::printf("%-22s %10.2f %12zu\n", "insert one by one", one_by_one, one_by_one_size);
+    std::printf("%-22s %10.2f %12zu\n", "reserve + insert", reserved, reserved_size);
+    std::printf("%-22s %10.2f %12zu\n", "range constructor", range, range_size);
+    return one_by_one_size == range_size && reserved_size == range_size ? 0 : 1;
+}
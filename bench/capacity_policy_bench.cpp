@@ -0,0 +1,69 @@
+/* Compares capacity policies of HashMap: modulo, fibonacci (power of two) and fastrange.
+   Build: g++ -std=c++17 -O2 -march=native -I.. capacity_policy_bench.cpp -o capacity_policy_bench
+   Usage: ./capacity_policy_bench [num_of_entries = 1000000]
+   First measures hash -> cell reduction alone, then insert and find of a whole HashMap. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../hashtable.h"
+
+// Keys are random already, so the hash is the identity (fastrange needs random high bits).
+struct IdentityHash {
+    size_t operator()(uint64_t key) const {
+        return static_cast<size_t>(key);
+    }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Policy>
+void run(const char* name, const std::vector<uint64_t>& keys) {
+    // Capacity which is not a power of two for the policies that allow it.
+    Policy policy;
+    policy.reset(Policy::round_up(keys.size() + keys.size() / 3));
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 10; ++repeat) {
+        for (uint64_t key : keys) {
+            checksum += policy.index(static_cast<size_t>(key + repeat));
+        }
+    }
+    double reduce_seconds = seconds_since(start);
+
+    HashMap<uint64_t, uint64_t, IdentityHash, std::equal_to<uint64_t>,
+            std::allocator<std::pair<const uint64_t, uint64_t>>, Policy> map;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t key : keys) {
+        map.insert(std::make_pair(key, key));
+    }
+    double insert_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t key : keys) {
+        checksum += map.find(key)->second;
+    }
+    double find_seconds = seconds_since(start);
+
+    std::printf("%-18s ns/reduce=%.2f ns/insert=%.1f ns/find=%.1f checksum=%llu\n", name,
+                reduce_seconds * 1e9 / (10 * keys.size()), insert_seconds * 1e9 / keys.size(),
+                find_seconds * 1e9 / keys.size(), static_cast<unsigned long long>(checksum));
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> keys(num_of_entries);
+    for (auto& key : keys) {
+        key = rng();
+    }
+    run<ModuloCapacity>("ModuloCapacity", keys);
+    run<FibonacciCapacity>("FibonacciCapacity", keys);
+    run<FastrangeCapacity>("FastrangeCapacity", keys);
+    return 0;
+}
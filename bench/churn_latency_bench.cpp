@@ -0,0 +1,61 @@
+/* Latency of find() under heavy insert/erase churn at a fixed table size.
+   Build: g++ -std=c++17 -O2 -march=native -I.. churn_latency_bench.cpp -o churn_latency_bench
+   Usage: ./churn_latency_bench [num_of_entries = 1000000] [num_of_rounds = 5000000]
+   Every round erases one live key, inserts a fresh one and times one find() of a live key. */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../hashtable.h"
+#include "../flat_hashmap.h"
+#include "../robin_hood_hashmap.h"
+
+template<class Map>
+void run(const char* name, size_t num_of_entries, size_t num_of_rounds) {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> live(num_of_entries);
+    Map map;
+    for (auto& key : live) {
+        key = rng();
+        map.insert(std::make_pair(key, key));
+    }
+
+    std::vector<uint32_t> latencies;
+    latencies.reserve(num_of_rounds);
+    uint64_t checksum = 0;
+    for (size_t round = 0; round < num_of_rounds; ++round) {
+        size_t victim = rng() % live.size();
+        map.erase(live[victim]);
+        live[victim] = rng();
+        map.insert(std::make_pair(live[victim], live[victim]));
+
+        uint64_t key = live[rng() % live.size()];
+        auto start = std::chrono::steady_clock::now();
+        auto it = map.find(key);
+        auto finish = std::chrono::steady_clock::now();
+        checksum += it->second;
+        latencies.push_back(static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count()));
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::printf("%-18s p50=%uns p99=%uns p99.9=%uns max=%uns checksum=%llu\n", name,
+                percentile(0.5), percentile(0.99), percentile(0.999), latencies.back(),
+                static_cast<unsigned long long>(checksum));
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t num_of_rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5000000;
+    run<HashMap<uint64_t, uint64_t>>("HashMap", num_of_entries, num_of_rounds);
+    run<FlatHashMap<uint64_t, uint64_t>>("FlatHashMap", num_of_entries, num_of_rounds);
+    run<RobinHoodHashMap<uint64_t, uint64_t>>("RobinHoodHashMap", num_of_entries, num_of_rounds);
+    return 0;
+}
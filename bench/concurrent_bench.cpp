@@ -0,0 +1,107 @@
+/* Throughput of a HashMap behind one global mutex against ConcurrentHashMap, 1 to 64 threads.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. concurrent_bench.cpp -o concurrent_bench
+   Usage: ./concurrent_bench [num_of_ops = 4000000] [num_of_keys = 1000000] [find_percent = 80]
+   The table is filled with half of the key range, then num_of_ops random operations are split
+   between the threads: find_percent of them are finds, the rest are inserts and erases in equal parts. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_hashmap.h"
+#include "../hashtable.h"
+
+// HashMap with one mutex, what the concurrent map replaces.
+class GlobalLockMap {
+  public:
+    bool find(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return map_.find(key) != map_.end();
+    }
+
+    void insert(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.try_emplace(key, key);
+    }
+
+    void erase(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.erase(key);
+    }
+
+  private:
+    std::mutex mutex_;
+    HashMap<uint64_t, uint64_t> map_;
+};
+
+class ShardedMap {
+  public:
+    bool find(uint64_t key) {
+        return map_.find(key).has_value();
+    }
+
+    void insert(uint64_t key) {
+        map_.try_emplace(key, key);
+    }
+
+    void erase(uint64_t key) {
+        map_.erase(key);
+    }
+
+  private:
+    ConcurrentHashMap<uint64_t, uint64_t> map_;
+};
+
+// Returns millions of operations per second.
+template<class Map>
+double run(size_t num_of_threads, size_t num_of_ops, size_t num_of_keys, size_t find_percent) {
+    Map map;
+    for (uint64_t key = 0; key < num_of_keys; key += 2) {
+        map.insert(key);
+    }
+    std::vector<std::thread> threads;
+    std::vector<size_t> found(num_of_threads, 0);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_of_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937_64 rng(t + 1);
+            size_t local_found = 0;
+            for (size_t op = t; op < num_of_ops; op += num_of_threads) {
+                uint64_t key = rng() % num_of_keys;
+                size_t kind = rng() % 100;
+                if (kind < find_percent) {
+                    local_found += map.find(key);
+                } else if (kind % 2 == 0) {
+                    map.insert(key);
+                } else {
+                    map.erase(key);
+                }
+            }
+            found[t] = local_found;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return num_of_ops / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    size_t num_of_keys = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    size_t find_percent = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 80;
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %18s %18s\n", "threads", "global mutex Mops", "sharded Mops");
+    for (size_t num_of_threads = 1; num_of_threads <= 64; num_of_threads *= 2) {
+        double global = run<GlobalLockMap>(num_of_threads, num_of_ops, num_of_keys, find_percent);
+        double sharded = run<ShardedMap>(num_of_threads, num_of_ops, num_of_keys, find_percent);
+        std::printf("%8zu %18.2f %18.2f\n", num_of_threads, global, sharded);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* Static lookup table of HTTP header names: HashMap built at startup against ConstexprHashMap.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. constexpr_bench.cpp -o constexpr_bench
+   Usage: ./constexpr_bench [num_of_lookups = 20000000]
+   Names are looked up in random order, a quarter of them are absent. Also prints how long
+   the runtime table takes to build, the constexpr one is built by the compiler. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "../constexpr_hashmap.h"
+#include "../hashtable.h"
+
+static constexpr std::pair<std::string_view, int> HEADERS[] = {
+    {"accept", 1}, {"accept-encoding", 2}, {"accept-language", 3}, {"authorization", 4},
+    {"cache-control", 5}, {"connection", 6}, {"content-encoding", 7}, {"content-length", 8},
+    {"content-type", 9}, {"cookie", 10}, {"date", 11}, {"etag", 12}, {"expires", 13},
+    {"host", 14}, {"if-match", 15}, {"if-modified-since", 16}, {"if-none-match", 17},
+    {"last-modified", 18}, {"location", 19}, {"origin", 20}, {"pragma", 21}, {"range", 22},
+    {"referer", 23}, {"server", 24}, {"set-cookie", 25}, {"transfer-encoding", 26},
+    {"upgrade", 27}, {"user-agent", 28}, {"vary", 29}, {"via", 30}, {"www-authenticate", 31},
+    {"x-forwarded-for", 32},
+};
+
+static constexpr ConstexprHashMap<std::string_view, int, std::size(HEADERS)> CONSTEXPR_HEADERS(HEADERS);
+
+static constexpr std::string_view ABSENT[] = {"x-request-id", "dnt", "te", "forwarded", "x-real-ip",
+                                              "content-md5", "warning", "allow"};
+
+template<class Find>
+double ns_per_lookup(const std::vector<std::string_view>& names, int64_t& checksum, Find find) {
+    auto start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (std::string_view name : names) {
+        checksum += find(name);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / names.size();
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_lookups = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+
+    std::mt19937_64 rng(1);
+    std::vector<std::string_view> names(num_of_lookups);
+    for (auto& name : names) {
+        name = rng() % 4 == 0 ? ABSENT[rng() % std::size(ABSENT)] : HEADERS[rng() % std::size(HEADERS)].first;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    HashMap<std::string_view, int> runtime_headers(std::begin(HEADERS), std::end(HEADERS));
+    double build_us = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6;
+
+    int64_t runtime_checksum = 0;
+    int64_t constexpr_checksum = 0;
+    double runtime = ns_per_lookup(names, runtime_checksum, [&runtime_headers](std::string_view name) {
+        auto it = runtime_headers.find(name);
+        return it != runtime_headers.end() ? it->second : 0;
+    });
+    double compile_time = ns_per_lookup(names, constexpr_checksum, [](std::string_view name) {
+        auto cell = CONSTEXPR_HEADERS.find(name);
+        return cell != nullptr ? cell->second : 0;
+    });
+
+    std::printf("%-18s %12s %12s\n", "table", "build us", "ns/lookup");
+    std::printf("%-18s %12.1f %12.1f\n", "HashMap", build_us, runtime);
+    std::printf("%-18s %12s %12.1f\n", "ConstexprHashMap", "0", compile_time);
+    return runtime_checksum == constexpr_checksum ? 0 : 1;
+}
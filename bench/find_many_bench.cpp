@@ -0,0 +1,92 @@
+/* Batched lookups of HashMap: a loop of find() against find_many() with prefetching.
+   Build: g++ -std=c++17 -O2 -march=native -I.. find_many_bench.cpp -o find_many_bench
+   Usage: ./find_many_bench [num_of_entries = 8000000] [num_of_lookups = 10000000] [batch = 1024]
+   Like a join probe: a batch of independent keys, half of them present, is looked up at once.
+   The default table takes about 0.5 GB, pass a bigger size if the last level cache is larger. */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../hashtable.h"
+#include "perf_counters.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+struct Result {
+    double ns_per_lookup;
+    double misses_per_lookup;
+    bool misses_available;
+    uint64_t checksum;
+};
+
+void print(const char* name, const Result& result) {
+    std::printf("%-12s %12.1f", name, result.ns_per_lookup);
+    if (result.misses_available) {
+        std::printf(" %16.2f\n", result.misses_per_lookup);
+    } else {
+        std::printf(" %16s\n", "n/a");
+    }
+}
+
+template<class Probe>
+Result run(const Map& map, const std::vector<uint64_t>& lookups, size_t batch, Probe probe) {
+    std::vector<Map::const_iterator> found(batch);
+    CacheMissCounter misses;
+    uint64_t checksum = 0;
+    misses.start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < lookups.size(); first += batch) {
+        size_t n = std::min(batch, lookups.size() - first);
+        probe(&lookups[first], n, found.data());
+        for (size_t i = 0; i < n; ++i) {
+            if (found[i] != map.end()) {
+                checksum += found[i]->second;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double num_of_misses = static_cast<double>(misses.stop());
+    return Result{seconds * 1e9 / lookups.size(), num_of_misses / lookups.size(), misses.available(), checksum};
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 8000000;
+    size_t num_of_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    size_t batch = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+
+    std::mt19937_64 rng(12);
+    std::vector<uint64_t> keys(num_of_entries);
+    Map map;
+    map.reserve(num_of_entries);
+    for (auto& key : keys) {
+        key = rng();
+        map.try_emplace(key, key);
+    }
+    std::vector<uint64_t> lookups(num_of_lookups);
+    for (auto& key : lookups) {
+        key = rng() % 2 ? keys[rng() % keys.size()] : rng();
+    }
+
+    const Map& table = map;
+    Result loop = run(table, lookups, batch, [&table](const uint64_t* keys, size_t n, Map::const_iterator* out) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = table.find(keys[i]);
+        }
+    });
+    Result batched = run(table, lookups, batch, [&table](const uint64_t* keys, size_t n, Map::const_iterator* out) {
+        table.find_many(keys, n, out);
+    });
+    if (loop.checksum != batched.checksum) {
+        std::printf("checksums differ\n");
+        return 1;
+    }
+
+    std::printf("%-12s %12s %16s\n", "probe", "ns/lookup", "misses/lookup");
+    print("find()", loop);
+    print("find_many()", batched);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/* Compares find() of the chained HashMap and the flat FlatHashMap on large integer tables.
+   Build: g++ -std=c++17 -O2 -march=native -I.. flat_find_bench.cpp -o flat_find_bench
+   Usage: ./flat_find_bench [num_of_entries = 10000000] [num_of_lookups = 10000000]
+   Prints nanoseconds and hardware cache misses per find() (misses need perf events). */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../hashtable.h"
+#include "../flat_hashmap.h"
+#include "perf_counters.h"
+
+template<class Map>
+void run(const char* name, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& lookups) {
+    Map map;
+    for (uint64_t key : keys) {
+        map.insert(std::make_pair(key, key));
+    }
+
+    CacheMissCounter misses;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    misses.start();
+    for (uint64_t key : lookups) {
+        auto it = map.find(key);
+        if (it != map.end()) {
+            checksum += it->second;
+        }
+    }
+    uint64_t miss_count = misses.stop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-12s size=%zu ns/find=%.1f", name, map.size(), seconds * 1e9 / lookups.size());
+    if (misses.available()) {
+        std::printf(" misses/find=%.2f", static_cast<double>(miss_count) / lookups.size());
+    } else {
+        std::printf(" misses/find=n/a");
+    }
+    std::printf(" checksum=%llu\n", static_cast<unsigned long long>(checksum));
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t num_of_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> keys(num_of_entries);
+    for (auto& key : keys) {
+        key = rng();
+    }
+    // Half of the lookups hit, half miss.
+    std::vector<uint64_t> lookups(num_of_lookups);
+    for (size_t i = 0; i < num_of_lookups; ++i) {
+        lookups[i] = (i % 2 == 0) ? keys[rng() % num_of_entries] : rng();
+    }
+
+    run<HashMap<uint64_t, uint64_t>>("HashMap", keys, lookups);
+    run<FlatHashMap<uint64_t, uint64_t>>("FlatHashMap", keys, lookups);
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* Lookups in HashMap against FrozenHashMap made by freeze().
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. frozen_bench.cpp -o frozen_bench
+   Usage: ./frozen_bench [num_of_entries = 10000000] [num_of_lookups = 10000000] [hit_percent = 50]
+   Random keys are looked up, hit_percent of them are present. Also prints how long freeze() takes
+   and how many bits per key the perfect hash uses. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../hashtable.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+template<class Find>
+double ns_per_lookup(const std::vector<uint64_t>& keys, uint64_t& checksum, Find find) {
+    auto start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (uint64_t key : keys) {
+        checksum += find(key);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / keys.size();
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t num_of_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    size_t hit_percent = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 50;
+
+    std::mt19937_64 rng(1);
+    Map map;
+    for (uint64_t key = 0; key < num_of_entries; ++key) {
+        map.insert({key * 0x9E3779B97F4A7C15, key});
+    }
+    std::vector<uint64_t> keys(num_of_lookups);
+    for (auto& key : keys) {
+        uint64_t index = rng() % num_of_entries;
+        key = rng() % 100 < hit_percent ? index * 0x9E3779B97F4A7C15 : index * 0x9E3779B97F4A7C15 + 1;
+    }
+
+    auto frozen = map.freeze();
+    uint64_t chained_checksum = 0;
+    uint64_t frozen_checksum = 0;
+    double chained = ns_per_lookup(keys, chained_checksum, [&map](uint64_t key) {
+        auto it = map.find(key);
+        return it != map.end() ? it->second : 0;
+    });
+    double perfect = ns_per_lookup(keys, frozen_checksum, [&frozen](uint64_t key) {
+        auto element = frozen.find(key);
+        return element != nullptr ? element->second : 0;
+    });
+
+    std::printf("freeze: %.1f ms, %.2f bits per key\n", frozen.build_seconds() * 1e3, frozen.bits_per_key());
+    std::printf("%-16s %12s\n", "table", "ns/lookup");
+    std::printf("%-16s %12.1f\n", "HashMap", chained);
+    std::printf("%-16s %12.1f\n", "FrozenHashMap", perfect);
+    return chained_checksum == frozen_checksum ? 0 : 1;
+}
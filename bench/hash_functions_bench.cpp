@@ -0,0 +1,135 @@
+/* Hash functions of hash_functions.h against std::hash: speed of the hash alone,
+   and chain lengths and lookup time of HashMap on typical id patterns.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. hash_functions_bench.cpp -o hash_functions_bench
+   Usage: ./hash_functions_bench [num_of_keys = 1000000]
+   Integer patterns: sequential ids, ids with stride 1024 and 4096 (record and page aligned
+   offsets), ids with a shard number in the high bits, random. String patterns: "user-%d" ids,
+   decimal numbers, and random bytes of fixed lengths. Chain lengths are taken from stats(). */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../hashtable.h"
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Hash, class Key>
+double ns_per_hash(const std::vector<Key>& keys, uint64_t& checksum) {
+    Hash hash;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 10; ++round) {
+        for (const auto& key : keys) {
+            checksum += hash(key);
+        }
+    }
+    return seconds_since(start) * 1e9 / (10.0 * keys.size());
+}
+
+template<class Hash, class Key>
+void table_row(const char* pattern, const char* name, const std::vector<Key>& keys, uint64_t& checksum) {
+    HashMap<Key, uint64_t, Hash> map;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        map.insert({keys[i], i});
+    }
+    double insert_ns = seconds_since(start) * 1e9 / keys.size();
+    start = std::chrono::steady_clock::now();
+    for (const auto& key : keys) {
+        checksum += map.find(key)->second;
+    }
+    double find_ns = seconds_since(start) * 1e9 / keys.size();
+    HashMapStats stats = map.stats();
+    printf("%-14s %-16s %8zu %8.2f %7.3f %10.1f %10.1f\n", pattern, name, stats.max_bucket_size,
+           stats.average_bucket_size, stats.empty_bucket_ratio, insert_ns, find_ns);
+}
+
+void integer_pattern(const char* pattern, const std::vector<uint64_t>& keys, uint64_t& checksum) {
+    table_row<std::hash<uint64_t>>(pattern, "std::hash", keys, checksum);
+    table_row<IntegerHash>(pattern, "IntegerHash", keys, checksum);
+}
+
+void string_pattern(const char* pattern, const std::vector<std::string>& keys, uint64_t& checksum) {
+    table_row<std::hash<std::string>>(pattern, "std::hash", keys, checksum);
+    table_row<StringHash>(pattern, "StringHash", keys, checksum);
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 rng(1);
+    uint64_t checksum = 0;
+
+    printf("hash alone, ns per key\n");
+    std::vector<uint64_t> integers(num_of_keys);
+    for (auto& key : integers) {
+        key = rng();
+    }
+    printf("%-10s %10s %10s\n", "key", "std::hash", "fast");
+    printf("%-10s %10.2f %10.2f\n", "uint64", ns_per_hash<std::hash<uint64_t>>(integers, checksum),
+           ns_per_hash<IntegerHash>(integers, checksum));
+    for (size_t length : {4, 8, 16, 24, 32, 64, 256}) {
+        std::vector<std::string> strings(num_of_keys / 4);
+        for (auto& key : strings) {
+            key.resize(length);
+            for (auto& c : key) {
+                c = static_cast<char>('a' + rng() % 26);
+            }
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "string %zu", length);
+        printf("%-10s %10.2f %10.2f\n", name, ns_per_hash<std::hash<std::string>>(strings, checksum),
+               ns_per_hash<StringHash>(strings, checksum));
+    }
+
+    printf("\nHashMap with ModuloCapacity, %zu keys\n", num_of_keys);
+    printf("%-14s %-16s %8s %8s %7s %10s %10s\n", "pattern", "hash", "max", "average", "empty", "insert ns",
+           "find ns");
+    std::vector<uint64_t> keys(num_of_keys);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        keys[i] = i;
+    }
+    integer_pattern("sequential", keys, checksum);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        keys[i] = i * 1024;
+    }
+    integer_pattern("stride 1024", keys, checksum);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        keys[i] = i * 4096;
+    }
+    integer_pattern("stride 4096", keys, checksum);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        keys[i] = (uint64_t(i % 64) << 48) | (i / 64);
+    }
+    integer_pattern("shard << 48", keys, checksum);
+    for (auto& key : keys) {
+        key = rng();
+    }
+    integer_pattern("random", keys, checksum);
+
+    std::vector<std::string> strings(num_of_keys);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        strings[i] = "user-" + std::to_string(i);
+    }
+    string_pattern("user-%d", strings, checksum);
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        strings[i] = std::to_string(i * 7919);
+    }
+    string_pattern("decimal", strings, checksum);
+    for (auto& key : strings) {
+        key.resize(32);
+        for (auto& c : key) {
+            c = static_cast<char>(rng());
+        }
+    }
+    string_pattern("random 32", strings, checksum);
+
+    printf("\nchecksum %llu\n", static_cast<unsigned long long>(checksum));
+}
@@ -0,0 +1,59 @@
+/* Per-insert latency of HashMap with stop-the-world and incremental rebuild.
+   Build: g++ -std=c++17 -O2 -march=native -I.. incremental_rebuild_bench.cpp -o incremental_rebuild_bench
+   Usage: ./incremental_rebuild_bench [num_of_entries = 10000000]
+   Inserts keys one by one and reports the worst insert in every doubling of the size,
+   so the growth rebuilds are visible as spikes in the stop-the-world column. */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../hashtable.h"
+
+// Worst insert latency (in microseconds) among sizes (2^(i-1); 2^i].
+std::vector<double> run(const std::vector<uint64_t>& keys, bool incremental, double& total_seconds) {
+    HashMap<uint64_t, uint64_t> map;
+    map.set_incremental_rebuild(incremental);
+    std::vector<double> worst;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto start = std::chrono::steady_clock::now();
+        map.insert(std::make_pair(keys[i], keys[i]));
+        double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        size_t bucket = 0;
+        while ((size_t(1) << bucket) <= i) {
+            bucket++;
+        }
+        if (worst.size() <= bucket) {
+            worst.resize(bucket + 1, 0);
+        }
+        worst[bucket] = std::max(worst[bucket], latency);
+    }
+    total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return worst;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    std::mt19937_64 rng(5);
+    std::vector<uint64_t> keys(num_of_entries);
+    for (auto& key : keys) {
+        key = rng();
+    }
+
+    double stop_the_world_seconds = 0;
+    double incremental_seconds = 0;
+    auto stop_the_world = run(keys, false, stop_the_world_seconds);
+    auto incremental = run(keys, true, incremental_seconds);
+
+    std::printf("%12s %22s %22s\n", "size up to", "stop-the-world max us", "incremental max us");
+    for (size_t i = 0; i < stop_the_world.size(); ++i) {
+        std::printf("%12zu %22.1f %22.1f\n", size_t(1) << i, stop_the_world[i], incremental[i]);
+    }
+    std::printf("total seconds: stop-the-world %.3f, incremental %.3f\n",
+                stop_the_world_seconds, incremental_seconds);
+    return 0;
+}
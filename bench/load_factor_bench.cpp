@@ -0,0 +1,48 @@
+/* Insert/erase oscillation near the grow and shrink thresholds of HashMap.
+   Build: g++ -std=c++17 -O2 -march=native -I.. load_factor_bench.cpp -o load_factor_bench
+   Usage: ./load_factor_bench [num_of_rounds = 1000000]
+   For every base size the table is filled to that size, then one key is inserted and erased
+   num_of_rounds times, like a queue which is almost empty or sits at a capacity boundary.
+   Without a hysteresis gap every round rebuilds the table. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../hashtable.h"
+
+template<class Map>
+double oscillate(size_t base_size, size_t num_of_rounds) {
+    Map map;
+    for (uint64_t key = 0; key < base_size; ++key) {
+        map.insert(std::make_pair(key, key));
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < num_of_rounds; ++round) {
+        uint64_t key = base_size + round;
+        map.insert(std::make_pair(key, key));
+        map.erase(key);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (2 * num_of_rounds);
+}
+
+using Allocator = std::allocator<std::pair<const uint64_t, uint64_t>>;
+using NoShrinkMap = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator,
+                            ModuloCapacity, NoShrinkLoadFactor>;
+using FibonacciMap = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator,
+                             FibonacciCapacity>;
+
+int main(int argc, char** argv) {
+    size_t num_of_rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const size_t base_sizes[] = {0, 1, 2, 3, 4, 9, 10, 20, 21, 44, 45, 1000, 1023, 1024, 4096};
+
+    std::printf("%10s %16s %16s %16s\n", "base size", "default ns/op", "no shrink ns/op", "fibonacci ns/op");
+    for (size_t base_size : base_sizes) {
+        std::printf("%10zu %16.1f %16.1f %16.1f\n", base_size,
+                    oscillate<HashMap<uint64_t, uint64_t>>(base_size, num_of_rounds),
+                    oscillate<NoShrinkMap>(base_size, num_of_rounds),
+                    oscillate<FibonacciMap>(base_size, num_of_rounds));
+    }
+    return 0;
+}
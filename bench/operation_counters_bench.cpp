@@ -0,0 +1,74 @@
+/* Work per operation of HashMap counted by OperationCounters: hash calls, key comparisons,
+   probed entries and node allocations. The numbers don't depend on the machine, so a change
+   in them is a regression (or an improvement) of the code, not noise.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. operation_counters_bench.cpp -o operation_counters_bench
+   Usage: ./operation_counters_bench [num_of_entries = 1000000]
+   Every row is one kind of operation on a table of num_of_entries elements, repeated
+   num_of_entries times, and the counters are divided by the number of operations. */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../hashtable.h"
+
+template<class K>
+using Map = HashMap<K, uint64_t, std::hash<K>, std::equal_to<K>, std::allocator<std::pair<const K, uint64_t>>,
+                    ModuloCapacity, DefaultLoadFactor, OperationCounters>;
+
+template<class K, class Operation>
+void measure(const char* key_type, const char* name, Map<K>& map, size_t num_of_operations, Operation operation) {
+    map.operation_counters().reset();
+    for (size_t i = 0; i < num_of_operations; ++i) {
+        operation(i);
+    }
+    const OperationCounters& counters = map.operation_counters();
+    double n = static_cast<double>(num_of_operations);
+    printf("%-8s %-22s %8.3f %8.3f %8.3f %8.3f\n", key_type, name, counters.hashes / n, counters.compares / n,
+           counters.probes / n, counters.allocations / n);
+}
+
+template<class K, class MakeKey>
+void run(const char* key_type, size_t num_of_entries, MakeKey make_key) {
+    std::vector<K> keys;
+    std::vector<K> missing;
+    for (size_t i = 0; i < num_of_entries; ++i) {
+        keys.push_back(make_key(i));
+        missing.push_back(make_key(i + num_of_entries));
+    }
+    Map<K> map;
+    measure(key_type, "insert (with growth)", map, num_of_entries, [&](size_t i) {
+        map.insert({keys[i], i});
+    });
+    measure(key_type, "find hit", map, num_of_entries, [&](size_t i) {
+        map.find(keys[i]);
+    });
+    measure(key_type, "find miss", map, num_of_entries, [&](size_t i) {
+        map.find(missing[i]);
+    });
+    measure(key_type, "operator[] hit", map, num_of_entries, [&](size_t i) {
+        map[keys[i]]++;
+    });
+    Map<K> reserved;
+    reserved.reserve(num_of_entries);
+    measure(key_type, "operator[] miss", reserved, num_of_entries, [&](size_t i) {
+        reserved[missing[i]] = i;
+    });
+    measure(key_type, "erase (with shrink)", map, num_of_entries, [&](size_t i) {
+        map.erase(keys[i]);
+    });
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    printf("%-8s %-22s %8s %8s %8s %8s\n", "keys", "operation", "hashes", "compares", "probes", "allocs");
+    run<uint64_t>("uint64", num_of_entries, [](size_t i) {
+        return static_cast<uint64_t>(i) * 0x9E3779B97F4A7C15ull;
+    });
+    run<std::string>("string", num_of_entries, [](size_t i) {
+        return "key-" + std::to_string(i);
+    });
+}
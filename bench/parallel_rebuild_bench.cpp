@@ -0,0 +1,45 @@
+/* Pause of a stop-the-world HashMap rebuild: one thread against set_parallel_rebuild(true).
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. parallel_rebuild_bench.cpp -o parallel_rebuild_bench
+   Usage: ./parallel_rebuild_bench [num_of_entries = 20000000]
+   The table is filled up to its growth threshold, the next insert triggers the rebuild
+   whose time is measured. The parallel rebuild uses every thread of ThreadPool::instance(). */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "../hashtable.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+// Returns seconds of the insert which grows a table of about num_of_entries elements.
+double growth_pause(size_t num_of_entries, bool parallel) {
+    Map map;
+    map.set_parallel_rebuild(parallel);
+    uint64_t key = 0;
+    size_t buckets = map.bucket_count();
+    while (map.size() < num_of_entries || map.bucket_count() == buckets) {
+        buckets = map.bucket_count();
+        auto start = std::chrono::steady_clock::now();
+        map.insert({key * 0x9E3779B97F4A7C15, key});
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        key++;
+        if (map.bucket_count() != buckets && map.size() >= num_of_entries) {
+            return seconds;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+
+    double serial = growth_pause(num_of_entries, false);
+    double parallel = growth_pause(num_of_entries, true);
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%-12s %12s\n", "rebuild", "pause ms");
+    std::printf("%-12s %12.1f\n", "serial", serial * 1e3);
+    std::printf("%-12s %12.1f\n", "parallel", parallel * 1e3);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* Full scans of HashMap: a loop over iterators against parallel_reduce() and parallel_count_if().
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. parallel_scan_bench.cpp -o parallel_scan_bench
+   Usage: ./parallel_scan_bench [num_of_entries = 20000000] [num_of_scans = 5]
+   Like a metrics sweep: the sum of the values and the number of values over a bound.
+   Parallel scans use every thread of ThreadPool::instance(). */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+
+#include "../hashtable.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+// Returns milliseconds per scan, the result of the last scan goes to checksum.
+template<class Scan>
+double ms_per_scan(size_t num_of_scans, uint64_t& checksum, Scan scan) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_of_scans; ++i) {
+        checksum = scan();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e3 / num_of_scans;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    size_t num_of_scans = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5;
+
+    Map map;
+    for (uint64_t key = 0; key < num_of_entries; ++key) {
+        map.insert({key * 0x9E3779B97F4A7C15, key});
+    }
+    uint64_t bound = num_of_entries / 3;
+
+    uint64_t serial_sum = 0;
+    uint64_t parallel_sum = 0;
+    uint64_t serial_count = 0;
+    uint64_t parallel_count = 0;
+    double serial_sum_ms = ms_per_scan(num_of_scans, serial_sum, [&] {
+        uint64_t sum = 0;
+        for (const auto& element : map) {
+            sum += element.second;
+        }
+        return sum;
+    });
+    double parallel_sum_ms = ms_per_scan(num_of_scans, parallel_sum, [&] {
+        return map.parallel_reduce(uint64_t(0), [](const Map::value_type& element) {
+            return element.second;
+        }, std::plus<uint64_t>());
+    });
+    double serial_count_ms = ms_per_scan(num_of_scans, serial_count, [&] {
+        uint64_t count = 0;
+        for (const auto& element : map) {
+            count += element.second > bound;
+        }
+        return count;
+    });
+    double parallel_count_ms = ms_per_scan(num_of_scans, parallel_count, [&] {
+        return map.parallel_count_if([bound](const Map::value_type& element) {
+            return element.second > bound;
+        });
+    });
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%-20s %12s %12s\n", "scan", "serial ms", "parallel ms");
+    std::printf("%-20s %12.1f %12.1f\n", "sum", serial_sum_ms, parallel_sum_ms);
+    std::printf("%-20s %12.1f %12.1f\n", "count over bound", serial_count_ms, parallel_count_ms);
+    return serial_sum == parallel_sum && serial_count == parallel_count ? 0 : 1;
+}
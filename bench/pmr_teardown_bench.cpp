@@ -0,0 +1,70 @@
+/* Request-scoped maps: HashMap with the global allocator against pmr::HashMap
+   in a std::pmr::monotonic_buffer_resource which is released after every request.
+   Build: g++ -std=c++17 -O2 -march=native -I.. pmr_teardown_bench.cpp -o pmr_teardown_bench
+   Usage: ./pmr_teardown_bench [num_of_requests = 20000] [entries_per_request = 200]
+   Every request fills a map with string keys, looks all of them up and throws the map away.
+   Fill and teardown are timed separately. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "../hashtable.h"
+
+struct Timings {
+    double fill_seconds = 0;
+    double teardown_seconds = 0;
+    uint64_t checksum = 0;
+};
+
+template<class Map, class String, class MakeMap>
+void run_request(const std::vector<std::string>& keys, MakeMap make_map, Timings& timings) {
+    auto start = std::chrono::steady_clock::now();
+    {
+        Map map = make_map();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            map.try_emplace(String(keys[i].data(), keys[i].size(), map.get_allocator()), i);
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            timings.checksum += map.at(String(keys[i].data(), keys[i].size(), map.get_allocator()));
+        }
+        auto filled = std::chrono::steady_clock::now();
+        timings.fill_seconds += std::chrono::duration<double>(filled - start).count();
+        start = filled;
+    }
+    timings.teardown_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    size_t entries_per_request = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < entries_per_request; ++i) {
+        keys.push_back("request-header-" + std::to_string(i * 7919));
+    }
+
+    using GlobalMap = HashMap<std::string, size_t>;
+    using ResourceMap = pmr::HashMap<std::pmr::string, size_t>;
+
+    Timings global;
+    for (size_t request = 0; request < num_of_requests; ++request) {
+        run_request<GlobalMap, std::string>(keys, [] { return GlobalMap(); }, global);
+    }
+
+    Timings resource;
+    std::vector<char> buffer(1 << 20);
+    for (size_t request = 0; request < num_of_requests; ++request) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        run_request<ResourceMap, std::pmr::string>(keys, [&arena] { return ResourceMap(&arena); }, resource);
+    }
+
+    std::printf("%-28s %16s %16s\n", "map", "fill us/request", "teardown us/req");
+    std::printf("%-28s %16.2f %16.2f\n", "HashMap", global.fill_seconds * 1e6 / num_of_requests,
+                global.teardown_seconds * 1e6 / num_of_requests);
+    std::printf("%-28s %16.2f %16.2f\n", "pmr::HashMap (monotonic)", resource.fill_seconds * 1e6 / num_of_requests,
+                resource.teardown_seconds * 1e6 / num_of_requests);
+    return global.checksum == resource.checksum ? 0 : 1;
+}
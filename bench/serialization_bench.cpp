@@ -0,0 +1,71 @@
+/* Checkpoint of a HashMap to disk: a loop over iterators and insert() against serialize()/deserialize().
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. serialization_bench.cpp -o serialization_bench
+   Usage: ./serialization_bench [num_of_entries = 10000000] [path = checkpoint.bin]
+   The loop writes key and value of every element with std::ostream::write and reloads them
+   with insert() into an empty table, as a checkpoint without the library support does. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "../hashtable.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+template<class Action>
+double ms_of(Action action) {
+    auto start = std::chrono::steady_clock::now();
+    action();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    std::string path = argc > 2 ? argv[2] : "checkpoint.bin";
+
+    Map map;
+    for (uint64_t key = 0; key < num_of_entries; ++key) {
+        map.insert({key * 0x9E3779B97F4A7C15, key});
+    }
+
+    double loop_save = ms_of([&] {
+        std::ofstream out(path, std::ios::binary);
+        uint64_t count = map.size();
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& element : map) {
+            out.write(reinterpret_cast<const char*>(&element.first), sizeof(element.first));
+            out.write(reinterpret_cast<const char*>(&element.second), sizeof(element.second));
+        }
+    });
+    Map loop_loaded;
+    double loop_load = ms_of([&] {
+        std::ifstream in(path, std::ios::binary);
+        uint64_t count = 0;
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            in.read(reinterpret_cast<char*>(&key), sizeof(key));
+            in.read(reinterpret_cast<char*>(&value), sizeof(value));
+            loop_loaded.insert({key, value});
+        }
+    });
+
+    double serialize = ms_of([&] {
+        std::ofstream out(path, std::ios::binary);
+        map.serialize(out);
+    });
+    Map loaded;
+    double deserialize = ms_of([&] {
+        std::ifstream in(path, std::ios::binary);
+        loaded.deserialize(in);
+    });
+    std::remove(path.c_str());
+
+    std::printf("%-24s %12s %12s\n", "checkpoint", "save ms", "load ms");
+    std::printf("%-24s %12.1f %12.1f\n", "iterators + insert()", loop_save, loop_load);
+    std::printf("%-24s %12.1f %12.1f\n", "serialize/deserialize", serialize, deserialize);
+    return loaded.size() == map.size() && loop_loaded.size() == map.size() ? 0 : 1;
+}
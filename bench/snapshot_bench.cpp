@@ -0,0 +1,100 @@
+/* Restart of a service: HashMap rebuilt by inserts against MappedHashMap over a snapshot.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. snapshot_bench.cpp -o snapshot_bench
+   Usage: ./snapshot_bench [num_of_entries = 20000000] [num_of_lookups = 1000000] [path = snapshot.bin]
+   Both start from the file written by save_snapshot(): the first one reads all records and inserts
+   them into a new HashMap, the second one maps the file. Then both look up random keys.
+   Drop the page cache before a run (echo 3 > /proc/sys/vm/drop_caches) to see cold start. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../hashtable.h"
+#include "../mapped_hashmap.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+template<class Action>
+double ms_of(Action action) {
+    auto start = std::chrono::steady_clock::now();
+    action();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3;
+}
+
+template<class Lookup>
+uint64_t lookups(const std::vector<uint64_t>& keys, Lookup lookup) {
+    uint64_t checksum = 0;
+    for (uint64_t key : keys) {
+        checksum += lookup(key);
+    }
+    return checksum;
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    size_t num_of_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    std::string path = argc > 3 ? argv[3] : "snapshot.bin";
+
+    double save_ms = 0;
+    {
+        Map map;
+        map.reserve(num_of_entries);
+        for (uint64_t key = 0; key < num_of_entries; ++key) {
+            map.insert({key * 0x9E3779B97F4A7C15, key});
+        }
+        save_ms = ms_of([&] {
+            save_snapshot(map, path);
+        });
+    }
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> keys(num_of_lookups);
+    for (auto& key : keys) {
+        key = (rng() % num_of_entries) * 0x9E3779B97F4A7C15;
+    }
+
+    uint64_t rebuilt_checksum = 0;
+    double rebuild_ms = 0;
+    double rebuilt_lookups_ms = 0;
+    {
+        Map map;
+        rebuild_ms = ms_of([&] {
+            MappedHashMap<uint64_t, uint64_t> snapshot(path);
+            map.reserve(snapshot.size());
+            for (const auto& record : snapshot) {
+                map.insert({record.first, record.second});
+            }
+        });
+        rebuilt_lookups_ms = ms_of([&] {
+            rebuilt_checksum = lookups(keys, [&map](uint64_t key) {
+                return map.at(key);
+            });
+        });
+    }
+
+    uint64_t mapped_checksum = 0;
+    double open_ms = 0;
+    double mapped_lookups_ms = 0;
+    {
+        std::unique_ptr<MappedHashMap<uint64_t, uint64_t>> mapped;
+        open_ms = ms_of([&] {
+            mapped.reset(new MappedHashMap<uint64_t, uint64_t>(path));
+        });
+        const auto& snapshot = *mapped;
+        mapped_lookups_ms = ms_of([&] {
+            mapped_checksum = lookups(keys, [&snapshot](uint64_t key) {
+                return snapshot.at(key);
+            });
+        });
+    }
+    std::remove(path.c_str());
+
+    std::printf("save_snapshot: %.1f ms\n", save_ms);
+    std::printf("%-22s %14s %14s\n", "start", "load ms", "lookups ms");
+    std::printf("%-22s %14.1f %14.1f\n", "insert every record", rebuild_ms, rebuilt_lookups_ms);
+    std::printf("%-22s %14.3f %14.1f\n", "map the snapshot", open_ms, mapped_lookups_ms);
+    return rebuilt_checksum == mapped_checksum ? 0 : 1;
+}
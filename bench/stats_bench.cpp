@@ -0,0 +1,49 @@
+/* HashMap::stats() of tables with different capacity policies, and the cost of a call.
+   Build: g++ -std=c++17 -O2 -march=native -pthread -I.. stats_bench.cpp -o stats_bench
+   Usage: ./stats_bench [num_of_entries = 1000000] [stride = 1024]
+   Keys are 0, stride, 2 * stride, ... hashed by std::hash (the identity): modulo puts them
+   into the cells whose numbers share the factors of stride and capacity, fibonacci mixes them.
+   (Fastrange would put them all into cell 0, it needs a mixed hash.) Prints chain lengths,
+   rebuild counts and memory of every table, then how long stats() takes. */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "../hashtable.h"
+
+template<class Policy>
+void run(const char* name, size_t num_of_entries, uint64_t stride) {
+    using Map = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                        std::allocator<std::pair<const uint64_t, uint64_t>>, Policy>;
+    Map map;
+    for (uint64_t key = 0; key < num_of_entries; ++key) {
+        map.insert({key * stride, key});
+    }
+    auto start = std::chrono::steady_clock::now();
+    HashMapStats stats = map.stats();
+    double stats_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%-10s %10zu %8zu %8.2f %7.3f %6zu %10.1f %10.1f %10.1f %9.2f\n", name, stats.num_of_cells,
+           stats.max_bucket_size, stats.average_bucket_size, stats.empty_bucket_ratio, stats.num_of_grows,
+           stats.rebuild_seconds * 1e3, stats.bucket_bytes / 1048576.0, stats.node_bytes / 1048576.0, stats_ms);
+    printf("           histogram:");
+    for (size_t size = 0; size < stats.bucket_size_histogram.size(); ++size) {
+        if (stats.bucket_size_histogram[size] > 0) {
+            printf(" %zu:%zu", size, stats.bucket_size_histogram[size]);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    size_t num_of_entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    uint64_t stride = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1024;
+
+    printf("%zu keys with stride %llu\n", num_of_entries, static_cast<unsigned long long>(stride));
+    printf("%-10s %10s %8s %8s %7s %6s %10s %10s %10s %9s\n", "policy", "cells", "max", "average",
+           "empty", "grows", "rebuild ms", "cells MiB", "nodes MiB", "stats ms");
+    run<ModuloCapacity>("modulo", num_of_entries, stride);
+    run<FibonacciCapacity>("fibonacci", num_of_entries, stride);
+}
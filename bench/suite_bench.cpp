@@ -0,0 +1,466 @@
+/* Benchmark suite: HashMap against std::unordered_map over workloads, key types, distributions and sizes.
+   Build: make suite_bench (or g++ -std=c++17 -O2 -march=native -pthread -I.. suite_bench.cpp -o suite_bench)
+   Usage: ./suite_bench [--format=csv|json] [--sizes=1000,10000,...] [--repeats=3] [--filter=text]
+   Workloads: insert, find_hit, find_miss, erase, upsert (operator[] increment), iterate, copy, clear.
+   Keys: uint64_t, a 16 byte struct and 24 character std::string.
+   Distributions: uniform (random keys in random order), zipf (random keys, skewed access, theta 0.99)
+   and sequential (keys 0, 1, 2, ... in order). Default sizes go from 1K to 10M elements,
+   past the last level cache of most machines; pass bigger --sizes if the cache is larger.
+   Every line of the result is one measurement: map, key, distribution, size, workload,
+   ns per operation (best of the repeats) and the number of operations of one repeat.
+   Lines with --filter text in "map,key,distribution,size,workload" are run, others skipped. */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../hashtable.h"
+
+struct Key16 {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const Key16& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+struct Key16Hash {
+    size_t operator()(const Key16& key) const {
+        return std::hash<uint64_t>()(key.low ^ (key.high * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+template<class Key>
+struct KeyTraits;
+
+template<>
+struct KeyTraits<uint64_t> {
+    using hash = DefaultHash<uint64_t>;
+    static const char* name() {
+        return "u64";
+    }
+    static uint64_t make(uint64_t id) {
+        return id;
+    }
+};
+
+template<>
+struct KeyTraits<Key16> {
+    using hash = Key16Hash;
+    static const char* name() {
+        return "key16";
+    }
+    static Key16 make(uint64_t id) {
+        return Key16{id, ~id};
+    }
+};
+
+template<>
+struct KeyTraits<std::string> {
+    using hash = DefaultHash<std::string>;
+    static const char* name() {
+        return "string24";
+    }
+    // Longer than the small string buffer, so keys live on the heap as in real maps.
+    static std::string make(uint64_t id) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "key-%020llu", static_cast<unsigned long long>(id));
+        return buffer;
+    }
+};
+
+// Bijection of 64 bit numbers (finalizer of MurmurHash3), makes random looking keys of ids.
+uint64_t scramble(uint64_t id) {
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdull;
+    id ^= id >> 33;
+    id *= 0xc4ceb9fe1a85ec53ull;
+    id ^= id >> 33;
+    return id;
+}
+
+/* Zipfian ranks in [0; n) by Gray et al. "Quickly generating billion-record synthetic databases"
+   (the generator of YCSB): O(n) to set up, O(1) per rank. */
+class ZipfGenerator {
+  public:
+    ZipfGenerator(uint64_t n, double theta): n_(n), theta_(theta) {
+        double zeta2 = zeta(2);
+        zetan_ = zeta(n);
+        alpha_ = 1.0 / (1.0 - theta);
+        eta_ = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+    }
+
+    template<class Rng>
+    uint64_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta_)) {
+            return std::min<uint64_t>(1, n_ - 1);
+        }
+        return std::min<uint64_t>(n_ - 1, static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_)));
+    }
+
+  private:
+    double zeta(uint64_t n) const {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(double(i), theta_);
+        }
+        return sum;
+    }
+
+  private:
+    uint64_t n_;
+    double theta_;
+    double zetan_;
+    double alpha_;
+    double eta_;
+};
+
+enum class Distribution { UNIFORM, ZIPF, SEQUENTIAL };
+
+const char* name_of(Distribution distribution) {
+    switch (distribution) {
+        case Distribution::UNIFORM:
+            return "uniform";
+        case Distribution::ZIPF:
+            return "zipf";
+        default:
+            return "sequential";
+    }
+}
+
+/* Ids of one size and distribution: inserted are the distinct ids put into a map (for zipf,
+   the ranks drawn by size draws, so fewer than size), hits are present ids and misses absent ids
+   in the order of the distribution. Hits are also the stream of upserts. */
+struct Workload {
+    std::vector<uint64_t> inserted;
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> misses;
+};
+
+Workload make_workload(Distribution distribution, size_t size) {
+    std::mt19937_64 rng(size);
+    Workload workload;
+    workload.inserted.resize(size);
+    workload.hits.resize(size);
+    workload.misses.resize(size);
+    if (distribution == Distribution::SEQUENTIAL) {
+        for (size_t i = 0; i < size; ++i) {
+            workload.inserted[i] = i;
+            workload.hits[i] = i;
+            workload.misses[i] = size + i;
+        }
+        return workload;
+    }
+    if (distribution == Distribution::UNIFORM) {
+        for (size_t i = 0; i < size; ++i) {
+            workload.inserted[i] = scramble(i);
+            workload.hits[i] = scramble(rng() % size);
+            workload.misses[i] = scramble(size + rng() % size);
+        }
+        return workload;
+    }
+    ZipfGenerator zipf(size, 0.99);
+    for (size_t i = 0; i < size; ++i) {
+        workload.inserted[i] = scramble(zipf(rng));
+        workload.hits[i] = scramble(zipf(rng));
+        workload.misses[i] = scramble(size + zipf(rng));
+    }
+    // Hits must be present: with repeats in the inserted stream some ranks are never drawn.
+    std::sort(workload.inserted.begin(), workload.inserted.end());
+    workload.inserted.erase(std::unique(workload.inserted.begin(), workload.inserted.end()), workload.inserted.end());
+    std::vector<uint64_t> present = workload.inserted;
+    std::shuffle(workload.inserted.begin(), workload.inserted.end(), rng);
+    for (auto& hit : workload.hits) {
+        if (!std::binary_search(present.begin(), present.end(), hit)) {
+            hit = present[rng() % present.size()];
+        }
+    }
+    return workload;
+}
+
+struct Options {
+    bool json = false;
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    size_t repeats = 3;
+    std::string filter;
+};
+
+struct Measurement {
+    const char* map;
+    const char* key;
+    const char* distribution;
+    size_t size;
+    const char* workload;
+
+    // The line of the measurement without results, what --filter is matched against.
+    std::string name() const {
+        return std::string(map) + "," + key + "," + distribution + "," + std::to_string(size) + "," + workload;
+    }
+};
+
+// Writes results as they come, so that a long run can be watched and a killed run keeps its lines.
+class Report {
+  public:
+    explicit Report(bool json): json_(json) {
+        if (!json_) {
+            std::printf("map,key,distribution,size,workload,ns_per_op,ops\n");
+        } else {
+            std::printf("[\n");
+        }
+    }
+
+    ~Report() {
+        if (json_) {
+            std::printf("\n]\n");
+        }
+    }
+
+    void add(const Measurement& measurement, double ns_per_op, size_t ops) {
+        if (!json_) {
+            std::printf("%s,%s,%s,%zu,%s,%.2f,%zu\n", measurement.map, measurement.key, measurement.distribution,
+                        measurement.size, measurement.workload, ns_per_op, ops);
+        } else {
+            std::printf("%s  {\"map\": \"%s\", \"key\": \"%s\", \"distribution\": \"%s\", \"size\": %zu, "
+                        "\"workload\": \"%s\", \"ns_per_op\": %.2f, \"ops\": %zu}",
+                        first_ ? "" : ",\n", measurement.map, measurement.key, measurement.distribution,
+                        measurement.size, measurement.workload, ns_per_op, ops);
+            first_ = false;
+        }
+        std::fflush(stdout);
+    }
+
+  private:
+    bool json_;
+    bool first_ = true;
+};
+
+// Consumed results, so that the compiler can't drop the measured work.
+volatile uint64_t sink;
+
+template<class Map, class Key>
+class Runner {
+  public:
+    Runner(const char* map_name, const Options& options, Report& report):
+            map_name_(map_name), options_(options), report_(report) {}
+
+    void run(Distribution distribution, size_t size, const Workload& ids) {
+        std::vector<Key> inserted = keys_of(ids.inserted);
+        std::vector<Key> hits = keys_of(ids.hits);
+        std::vector<Key> misses = keys_of(ids.misses);
+        Measurement measurement{map_name_, KeyTraits<Key>::name(), name_of(distribution), size, ""};
+        auto named = [&measurement](const char* workload) {
+            measurement.workload = workload;
+            return measurement;
+        };
+        // Small sizes are repeated, so that every measurement takes about a million operations.
+        size_t rounds = std::max<size_t>(1, 1000000 / size);
+
+        measure(named("insert"), inserted.size() * rounds, [&](Timer& timer) {
+            for (size_t round = 0; round < rounds; ++round) {
+                Map map;
+                timer.start();
+                for (const auto& key : inserted) {
+                    map.insert({key, 1});
+                }
+                timer.stop();
+                sink = map.size();
+            }
+        });
+        Map filled;
+        for (const auto& key : inserted) {
+            filled.insert({key, 1});
+        }
+        measure(named("find_hit"), hits.size() * rounds, [&](Timer& timer) {
+            uint64_t found = 0;
+            timer.start();
+            for (size_t round = 0; round < rounds; ++round) {
+                for (const auto& key : hits) {
+                    found += filled.find(key) != filled.end();
+                }
+            }
+            timer.stop();
+            sink = found;
+        });
+        measure(named("find_miss"), misses.size() * rounds, [&](Timer& timer) {
+            uint64_t found = 0;
+            timer.start();
+            for (size_t round = 0; round < rounds; ++round) {
+                for (const auto& key : misses) {
+                    found += filled.find(key) != filled.end();
+                }
+            }
+            timer.stop();
+            sink = found;
+        });
+        measure(named("erase"), inserted.size() * rounds, [&](Timer& timer) {
+            for (size_t round = 0; round < rounds; ++round) {
+                Map map(filled);
+                timer.start();
+                for (const auto& key : inserted) {
+                    map.erase(key);
+                }
+                timer.stop();
+                sink = map.size();
+            }
+        });
+        measure(named("upsert"), hits.size() * rounds, [&](Timer& timer) {
+            for (size_t round = 0; round < rounds; ++round) {
+                Map map;
+                timer.start();
+                for (const auto& key : hits) {
+                    map[key]++;
+                }
+                timer.stop();
+                sink = map.size();
+            }
+        });
+        measure(named("iterate"), filled.size() * rounds, [&](Timer& timer) {
+            uint64_t sum = 0;
+            timer.start();
+            for (size_t round = 0; round < rounds; ++round) {
+                for (const auto& element : filled) {
+                    sum += element.second;
+                }
+            }
+            timer.stop();
+            sink = sum;
+        });
+        measure(named("copy"), filled.size() * rounds, [&](Timer& timer) {
+            for (size_t round = 0; round < rounds; ++round) {
+                timer.start();
+                Map map(filled);
+                timer.stop();
+                sink = map.size();
+            }
+        });
+        measure(named("clear"), filled.size() * rounds, [&](Timer& timer) {
+            for (size_t round = 0; round < rounds; ++round) {
+                Map map(filled);
+                timer.start();
+                map.clear();
+                timer.stop();
+                sink = map.size();
+            }
+        });
+    }
+
+  private:
+    // Sums the time between start() and stop() calls.
+    class Timer {
+      public:
+        void start() {
+            start_ = std::chrono::steady_clock::now();
+        }
+
+        void stop() {
+            total_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+        double seconds() const {
+            return total_;
+        }
+
+      private:
+        std::chrono::steady_clock::time_point start_;
+        double total_ = 0;
+    };
+
+    std::vector<Key> keys_of(const std::vector<uint64_t>& ids) const {
+        std::vector<Key> keys;
+        keys.reserve(ids.size());
+        for (uint64_t id : ids) {
+            keys.push_back(KeyTraits<Key>::make(id));
+        }
+        return keys;
+    }
+
+    template<class Body>
+    void measure(const Measurement& measurement, size_t ops, Body body) {
+        if (measurement.name().find(options_.filter) == std::string::npos) {
+            return;
+        }
+        double best = 0;
+        for (size_t repeat = 0; repeat < options_.repeats; ++repeat) {
+            Timer timer;
+            body(timer);
+            if (repeat == 0 || timer.seconds() < best) {
+                best = timer.seconds();
+            }
+        }
+        report_.add(measurement, best * 1e9 / std::max<size_t>(1, ops), ops);
+    }
+
+  private:
+    const char* map_name_;
+    const Options& options_;
+    Report& report_;
+};
+
+template<class Key>
+void run_key(Distribution distribution, size_t size, const Workload& ids, const Options& options, Report& report) {
+    using Hash = typename KeyTraits<Key>::hash;
+    Runner<HashMap<Key, uint64_t, Hash>, Key>("HashMap", options, report).run(distribution, size, ids);
+    Runner<std::unordered_map<Key, uint64_t, Hash>, Key>("std::unordered_map", options, report).run(distribution, size, ids);
+}
+
+Options parse(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--format=json") == 0) {
+            options.json = true;
+        } else if (std::strcmp(arg, "--format=csv") == 0) {
+            options.json = false;
+        } else if (std::strncmp(arg, "--sizes=", 8) == 0) {
+            options.sizes.clear();
+            for (const char* p = arg + 8; *p != '\0';) {
+                char* end = nullptr;
+                options.sizes.push_back(std::strtoull(p, &end, 10));
+                p = *end == ',' ? end + 1 : end;
+                if (end == p && *p != '\0') {
+                    break;
+                }
+            }
+        } else if (std::strncmp(arg, "--repeats=", 10) == 0) {
+            options.repeats = std::max<size_t>(1, std::strtoull(arg + 10, nullptr, 10));
+        } else if (std::strncmp(arg, "--filter=", 9) == 0) {
+            options.filter = arg + 9;
+        } else {
+            std::fprintf(stderr, "usage: %s [--format=csv|json] [--sizes=1000,10000,...] [--repeats=3] [--filter=text]\n",
+                         argv[0]);
+            std::exit(2);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options = parse(argc, argv);
+    Report report(options.json);
+    for (size_t size : options.sizes) {
+        if (size == 0) {
+            continue;
+        }
+        for (Distribution distribution : {Distribution::UNIFORM, Distribution::ZIPF, Distribution::SEQUENTIAL}) {
+            Workload ids = make_workload(distribution, size);
+            run_key<uint64_t>(distribution, size, ids, options, report);
+            run_key<Key16>(distribution, size, ids, options, report);
+            run_key<std::string>(distribution, size, ids, options, report);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hash_functions.h"
+
+/* Capacity policies of HashMap: which capacities are allowed
+   and how a hash is reduced to the index of a cell.
+   Interface of a policy:
+      1. static size_t round_up(size_t capacity) - smallest allowed capacity not less than given.
+      2. void reset(size_t capacity) - prepares index() for a table of that (rounded) capacity.
+      3. size_t index(size_t hash) const - cell of the hash, less than capacity. */
+
+/* Any capacity, cell is hash % capacity.
+   Works with any hash, but costs a hardware division on every query. */
+class ModuloCapacity {
+  public:
+    static size_t round_up(size_t capacity) {
+        return capacity;
+    }
+
+    void reset(size_t capacity) {
+        capacity_ = capacity;
+    }
+
+    size_t index(size_t hash) const {
+        return hash % capacity_;
+    }
+
+  private:
+    size_t capacity_ = 1;
+};
+
+/* Power of two capacity, cell is the high bits of hash * 2^64 / phi (fibonacci hashing).
+   One multiplication and one shift. The multiplication mixes low bits of the hash into the
+   high ones, so identity hashes of integers (and strided keys) spread well. */
+class FibonacciCapacity {
+  public:
+    static size_t round_up(size_t capacity) {
+        size_t result = 2;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    void reset(size_t capacity) {
+        shift_ = 64;
+        while ((size_t(1) << (64 - shift_)) < capacity) {
+            shift_--;
+        }
+    }
+
+    size_t index(size_t hash) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+  private:
+    unsigned shift_ = 63;
+};
+
+/* Any capacity, cell is (hash * capacity) / 2^64 (Lemire's fastrange, multiply-high).
+   One multiplication, but it only looks at the high bits of the hash,
+   so the hash must be well mixed: std::hash of integers is the identity and puts
+   all small keys into cell 0. */
+class FastrangeCapacity {
+  public:
+    static size_t round_up(size_t capacity) {
+        return capacity;
+    }
+
+    void reset(size_t capacity) {
+        capacity_ = capacity;
+    }
+
+    size_t index(size_t hash) const {
+        return static_cast<size_t>(multiply_high(static_cast<uint64_t>(hash), static_cast<uint64_t>(capacity_)));
+    }
+
+  private:
+    size_t capacity_ = 1;
+};
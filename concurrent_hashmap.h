@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+#include "hashtable.h"
+
+/* Thread safe hashtable with lock striping.
+   Keys are split into a power of two number of shards by the high bits of the mixed hash,
+   every shard is a HashMap with its own reader-writer lock, so it grows and shrinks
+   (rebuilds) on its own and blocks only the threads which use the same shard.
+   Every operation locks exactly one shard, so it is atomic for its key.
+   Lookups take a shared lock and return copies of values: references and iterators
+   would outlive the lock. Use update() to change a value in place.
+   size() and for_each() lock shards one by one, they are not atomic for the whole table.
+   Hash and KeyEqual are called from many threads at once, they must be const and thread safe. */
+template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType>,
+         class KeyEqual = std::equal_to<KeyType>>
+class ConcurrentHashMap {
+  public:
+    // Number of shards if it is not given to the constructor.
+    static const size_t DEFAULT_NUM_OF_SHARDS;
+
+    using value_type = std::pair<const KeyType, ValueType>;
+    using map_type = HashMap<KeyType, ValueType, Hash, KeyEqual>;
+
+    // Number of shards is rounded up to a power of two.
+    explicit ConcurrentHashMap(size_t num_of_shards = ConcurrentHashMap::DEFAULT_NUM_OF_SHARDS,
+                               const Hash& hash_function = Hash(), const KeyEqual& key_equal = KeyEqual()):
+                               hasher_(hash_function) {
+        shard_bits_ = 0;
+        while ((size_t(1) << shard_bits_) < num_of_shards) {
+            shard_bits_++;
+        }
+        num_of_shards_ = size_t(1) << shard_bits_;
+        shards_.reset(new Shard[num_of_shards_]);
+        for (size_t i = 0; i < num_of_shards_; ++i) {
+            shards_[i].map = map_type(hash_function, key_equal);
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    // Inserts an element if its key is absent. Returns whether the element was inserted.
+    bool insert(const value_type& pair) {
+        Shard& shard = shard_of(pair.first);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.insert(pair).second;
+    }
+
+    bool insert(value_type&& pair) {
+        Shard& shard = shard_of(pair.first);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.insert(std::move(pair)).second;
+    }
+
+    // Constructs the value from args if key is absent. Returns whether the element was inserted.
+    template<class... Args>
+    bool try_emplace(const KeyType& key, Args&&... args) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.try_emplace(key, std::forward<Args>(args)...).second;
+    }
+
+    // Inserts the value or assigns it to the existing element. Returns whether the element was inserted.
+    template<class Value>
+    bool insert_or_assign(const KeyType& key, Value&& value) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.insert_or_assign(key, std::forward<Value>(value)).second;
+    }
+
+    // Returns a copy of the value by key, or nothing if key not found.
+    std::optional<ValueType> find(const KeyType& key) const {
+        const Shard& shard = shard_of(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    bool contains(const KeyType& key) const {
+        const Shard& shard = shard_of(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.contains(key);
+    }
+
+    size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    // Erases the element by key. Returns whether it was present.
+    bool erase(const KeyType& key) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        size_t old_size = shard.map.size();
+        shard.map.erase(key);
+        return shard.map.size() != old_size;
+    }
+
+    /* Calls fn(value&) for the element by key under the lock of its shard.
+       Returns false if key not found. fn must not use this map. */
+    template<class Function>
+    bool update(const KeyType& key, Function fn) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    }
+
+    /* Inserts an element with the value constructed from args if key is absent,
+       then calls fn(value&), all under one lock. E.g. counters: upsert(key, fn, 0). */
+    template<class Function, class... Args>
+    void upsert(const KeyType& key, Function fn, Args&&... args) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        fn(shard.map.try_emplace(key, std::forward<Args>(args)...).first->second);
+    }
+
+    // Calls fn(const value_type&) for every element, shard by shard under shared locks.
+    template<class Function>
+    void for_each(Function fn) const {
+        for (size_t i = 0; i < num_of_shards_; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            for (const auto &element : shards_[i].map) {
+                fn(element);
+            }
+        }
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for (size_t i = 0; i < num_of_shards_; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            result += shards_[i].map.size();
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < num_of_shards_; ++i) {
+            std::unique_lock<std::shared_mutex> lock(shards_[i].mutex);
+            shards_[i].map.clear();
+        }
+    }
+
+    // Prepares every shard for its part of count elements.
+    void reserve(size_t count) {
+        for (size_t i = 0; i < num_of_shards_; ++i) {
+            std::unique_lock<std::shared_mutex> lock(shards_[i].mutex);
+            shards_[i].map.reserve(count / num_of_shards_ + 1);
+        }
+    }
+
+    size_t num_of_shards() const {
+        return num_of_shards_;
+    }
+
+  private:
+    // Shards are aligned to cache lines, so that locks of neighbours do not share a line.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        map_type map;
+    };
+
+    /* Shard of the key: high bits of the hash multiplied by 2^64 / phi.
+       Shard maps reduce the hash by its low bits (or by all of them), the multiplication
+       makes the shard independent from the cell inside the shard. */
+    size_t shard_index(const KeyType& key) const {
+        if (shard_bits_ == 0) {
+            return 0;
+        }
+        uint64_t mixed = static_cast<uint64_t>(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(mixed >> (64 - shard_bits_));
+    }
+
+    Shard& shard_of(const KeyType& key) {
+        return shards_[shard_index(key)];
+    }
+
+    const Shard& shard_of(const KeyType& key) const {
+        return shards_[shard_index(key)];
+    }
+
+  private:
+    Hash hasher_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t num_of_shards_ = 1;
+    unsigned shard_bits_ = 0;
+};
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual>
+constexpr size_t ConcurrentHashMap<KeyType, ValueType, Hash, KeyEqual>::DEFAULT_NUM_OF_SHARDS = 64;
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/* Hash which can be computed at compile time: std::hash can't.
+   Strings are hashed by FNV-1a, integers and enums by the finalizer of MurmurHash3. */
+struct ConstexprHash {
+    constexpr size_t operator()(std::string_view key) const {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (char c : key) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    template<class T, class = typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+    constexpr size_t operator()(T key) const {
+        uint64_t hash = static_cast<uint64_t>(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return static_cast<size_t>(hash);
+    }
+};
+
+// Number of cells of a ConstexprHashMap of size elements: a power of two, load factor at most 1/2.
+constexpr size_t constexpr_hashmap_capacity(size_t size) {
+    size_t capacity = 2;
+    while (capacity < 2 * size) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/* Fixed hash table with open addressing (linear probing) which is built at compile time:
+      static constexpr auto OPCODES = make_constexpr_hashmap<std::string_view, int>({{"add", 1}, {"sub", 2}});
+      static_assert(OPCODES.at("sub") == 2);
+   The table is a std::array inside the object, it is never allocated, and a constexpr
+   variable is initialized by the compiler: no code runs for it at startup.
+   KeyType and ValueType must be literal and default constructible, keys must be unique.
+   A repeated key is a compile error in a constant expression, std::invalid_argument otherwise. */
+template<class KeyType, class ValueType, size_t Size, class Hash = ConstexprHash,
+         class KeyEqual = std::equal_to<KeyType>>
+class ConstexprHashMap {
+  public:
+    // Cell of the table, first and second are valid if used is true.
+    struct value_type {
+        KeyType first{};
+        ValueType second{};
+        bool used = false;
+    };
+
+    constexpr explicit ConstexprHashMap(const std::pair<KeyType, ValueType> (&elements)[Size],
+                                        const Hash& hash_function = Hash(), const KeyEqual& key_equal = KeyEqual()):
+            hasher_(hash_function), key_equal_(key_equal) {
+        for (size_t i = 0; i < Size; ++i) {
+            size_t cell = cell_of(elements[i].first);
+            if (cells_[cell].used) {
+                throw std::invalid_argument("ConstexprHashMap: repeated key");
+            }
+            cells_[cell].first = elements[i].first;
+            cells_[cell].second = elements[i].second;
+            cells_[cell].used = true;
+        }
+    }
+
+    // Cell of the key, nullptr if key is absent.
+    template<class K>
+    constexpr const value_type* find(const K& key) const {
+        const value_type& cell = cells_[cell_of(key)];
+        return cell.used ? &cell : nullptr;
+    }
+
+    // If key not found, throws std::out_of_range.
+    template<class K>
+    constexpr const ValueType& at(const K& key) const {
+        const value_type* cell = find(key);
+        if (cell == nullptr) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return cell->second;
+    }
+
+    template<class K>
+    constexpr size_t count(const K& key) const {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    template<class K>
+    constexpr bool contains(const K& key) const {
+        return find(key) != nullptr;
+    }
+
+    constexpr size_t size() const {
+        return Size;
+    }
+
+    constexpr bool empty() const {
+        return Size == 0;
+    }
+
+    constexpr size_t bucket_count() const {
+        return cells_.size();
+    }
+
+  private:
+    // Cell of the key, or the empty cell where it would be. The table always has empty cells.
+    template<class K>
+    constexpr size_t cell_of(const K& key) const {
+        size_t mask = cells_.size() - 1;
+        size_t cell = hasher_(key) & mask;
+        while (cells_[cell].used && !key_equal_(cells_[cell].first, key)) {
+            cell = (cell + 1) & mask;
+        }
+        return cell;
+    }
+
+  private:
+    Hash hasher_;
+    KeyEqual key_equal_;
+    std::array<value_type, constexpr_hashmap_capacity(Size)> cells_{};
+};
+
+/* Makes a ConstexprHashMap of the pairs, the size is deduced:
+   make_constexpr_hashmap<std::string_view, int>({{"a", 1}, {"b", 2}}). */
+template<class KeyType, class ValueType, class Hash = ConstexprHash, class KeyEqual = std::equal_to<KeyType>, size_t Size>
+constexpr ConstexprHashMap<KeyType, ValueType, Size, Hash, KeyEqual> make_constexpr_hashmap(
+        const std::pair<KeyType, ValueType> (&elements)[Size], const Hash& hash_function = Hash(),
+        const KeyEqual& key_equal = KeyEqual()) {
+    return ConstexprHashMap<KeyType, ValueType, Size, Hash, KeyEqual>(elements, hash_function, key_equal);
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/* Epoch based reclamation for lock-free containers.
+   A thread which reads shared pointers holds a Guard. Memory unlinked by a container is passed
+   to retire() and freed only when every thread that could have seen it has left its guard:
+   an object retired at epoch e is freed once the global epoch reaches e + 2, and the epoch
+   only advances when all threads inside guards have announced the current one.
+   Entering a guard writes only the announcement of the calling thread, which lives
+   in its own cache line, so readers do not write memory shared with other threads.
+   One reclaimer serves all containers of the process. */
+class EpochReclaimer {
+  public:
+    // Number of retired objects a thread keeps before it tries to advance the epoch and free them.
+    static const size_t RETIRE_BATCH;
+
+    // Holds the calling thread inside the current epoch. Guards may be nested.
+    class Guard {
+      public:
+        Guard(): reclaimer_(EpochReclaimer::instance()) {
+            reclaimer_.enter();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() {
+            reclaimer_.leave();
+        }
+
+      private:
+        EpochReclaimer& reclaimer_;
+    };
+
+    static EpochReclaimer& instance() {
+        static EpochReclaimer reclaimer;
+        return reclaimer;
+    }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // Frees everything that is still retired, no thread may use the containers any more.
+    ~EpochReclaimer() {
+        Record* record = records_.load();
+        while (record != nullptr) {
+            for (auto& retired : record->retired) {
+                retired.deleter(retired.pointer);
+            }
+            Record* next = record->next;
+            delete record;
+            record = next;
+        }
+        for (auto& retired : orphans_) {
+            retired.deleter(retired.pointer);
+        }
+    }
+
+    // Deletes pointer when no guard can reach it any more. Must be called after it is unlinked.
+    template<class T>
+    void retire(T* pointer) {
+        retire(pointer, [](void* object) {
+            delete static_cast<T*>(object);
+        });
+    }
+
+    void retire(void* pointer, void (*deleter)(void*)) {
+        Record* record = local_record();
+        record->retired.push_back(Retired{pointer, deleter, epoch_.load()});
+        if (record->retired.size() >= EpochReclaimer::RETIRE_BATCH) {
+            try_advance();
+            free_expired(record->retired);
+            std::unique_lock<std::mutex> lock(orphans_mutex_, std::try_to_lock);
+            if (lock.owns_lock()) {
+                free_expired(orphans_);
+            }
+        }
+    }
+
+  private:
+    struct Retired {
+        void* pointer;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // Announcement of one thread, 0 if the thread is outside of guards.
+    struct alignas(64) Record {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{true};
+        Record* next = nullptr;
+        // Fields below are used only by the owner thread.
+        size_t depth = 0;
+        std::vector<Retired> retired;
+    };
+
+    // Gives the record back when its thread exits, retired objects go to the orphans.
+    struct ThreadHandle {
+        Record* record = nullptr;
+
+        ~ThreadHandle() {
+            if (record != nullptr) {
+                EpochReclaimer::instance().release(record);
+            }
+        }
+    };
+
+    EpochReclaimer() {}
+
+    Record* local_record() {
+        thread_local ThreadHandle handle;
+        if (handle.record == nullptr) {
+            handle.record = acquire_record();
+        }
+        return handle.record;
+    }
+
+    // Reuses a record of an exited thread or adds a new one to the list.
+    Record* acquire_record() {
+        for (Record* record = records_.load(); record != nullptr; record = record->next) {
+            bool in_use = false;
+            if (!record->in_use.load() && record->in_use.compare_exchange_strong(in_use, true)) {
+                return record;
+            }
+        }
+        Record* record = new Record();
+        record->next = records_.load();
+        while (!records_.compare_exchange_weak(record->next, record)) {}
+        return record;
+    }
+
+    void release(Record* record) {
+        {
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            orphans_.insert(orphans_.end(), record->retired.begin(), record->retired.end());
+        }
+        record->retired.clear();
+        record->epoch.store(0);
+        record->in_use.store(false);
+    }
+
+    /* Announces the current epoch. It is read again after the announcement: if it moved,
+       a reclaimer could have missed the announcement, so the new epoch is announced. */
+    void enter() {
+        Record* record = local_record();
+        if (record->depth++ > 0) {
+            return;
+        }
+        uint64_t epoch = epoch_.load();
+        while (true) {
+            record->epoch.store(epoch);
+            uint64_t current = epoch_.load();
+            if (current == epoch) {
+                break;
+            }
+            epoch = current;
+        }
+    }
+
+    void leave() {
+        Record* record = local_record();
+        if (--record->depth == 0) {
+            record->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // Moves the epoch forward if every thread inside a guard has announced the current one.
+    void try_advance() {
+        uint64_t epoch = epoch_.load();
+        for (Record* record = records_.load(); record != nullptr; record = record->next) {
+            uint64_t announced = record->epoch.load();
+            if (announced != 0 && announced != epoch) {
+                return;
+            }
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+    void free_expired(std::vector<Retired>& retired) {
+        uint64_t epoch = epoch_.load();
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i) {
+            if (retired[i].epoch + 2 <= epoch) {
+                retired[i].deleter(retired[i].pointer);
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+
+  private:
+    std::atomic<uint64_t> epoch_{1};
+    std::atomic<Record*> records_{nullptr};
+    // Retired objects of exited threads.
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+inline constexpr size_t EpochReclaimer::RETIRE_BATCH = 64;
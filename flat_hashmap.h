@@ -0,0 +1,559 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash_functions.h"
+#include "map_slot.h"
+
+/* Hashtable with open addressing in the Swiss-table style.
+   Same interface as HashMap, but elements are stored inline in one flat array of slots.
+   Every slot has one control byte: empty, deleted, or the low 7 bits of the element hash.
+   Slots are grouped by 16, and the whole group of control bytes is compared
+   with one SSE2 instruction, so a lookup usually touches one control line and one slot.
+   Insert may move elements, so iterators and references are invalidated by insert.
+   Complexity is amortized O(1) for a query.
+   Memory is linear from number of elements inside the table. */
+template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType> >
+class FlatHashMap {
+  public:
+    // Number of slots probed at once.
+    static const size_t GROUP_SIZE;
+    // Minimal number of groups. Also used for initialization.
+    static const size_t MIN_NUM_OF_GROUPS;
+
+    using value_type = std::pair<const KeyType, ValueType>;
+
+    class iterator;
+    class const_iterator;
+
+    FlatHashMap(): hasher_() {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+    }
+
+    FlatHashMap(const Hash& hash_function): hasher_(hash_function) {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+    }
+
+    template<class ForwardIterator>
+    FlatHashMap(ForwardIterator begin, ForwardIterator end, const Hash& hash_function = Hash()):
+                                                                  hasher_(hash_function) {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+        while (begin != end) {
+            insert(*begin);
+            ++begin;
+        }
+    }
+
+    FlatHashMap(std::initializer_list<std::pair<KeyType, ValueType>> initializer_list,
+                Hash hash_function = Hash()): hasher_(hash_function) {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+        for (auto it = initializer_list.begin(); it != initializer_list.end(); ++it) {
+            insert(*it);
+        }
+    }
+
+    FlatHashMap(const FlatHashMap& other): hasher_(other.hasher_) {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+        for (const auto& element : other) {
+            insert(element);
+        }
+    }
+
+    FlatHashMap(FlatHashMap&& other): hasher_(other.hasher_) {
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+        swap(other);
+    }
+
+    FlatHashMap& operator=(const FlatHashMap& other) {
+        if (this != &other) {
+            FlatHashMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    FlatHashMap& operator=(FlatHashMap&& other) {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() {
+        destroy_elements();
+    }
+
+    void swap(FlatHashMap& other) {
+        std::swap(hasher_, other.hasher_);
+        groups_.swap(other.groups_);
+        slots_.swap(other.slots_);
+        std::swap(current_size_, other.current_size_);
+        std::swap(growth_left_, other.growth_left_);
+    }
+
+    /* Insert an element into the hashtable by its key.
+       If key is already present, do nothing.
+       If there are no free slots left within the load factor, table grows in O(total_size) time. */
+    void insert(const std::pair<const KeyType, ValueType> &pair) {
+        size_t hash = hash_key(pair.first);
+        if (find_position(pair.first, hash) != capacity()) {
+            return;
+        }
+        size_t position = prepare_insert(hash);
+        slots_[position].construct(pair);
+        publish_insert(position, hash);
+    }
+
+    /* Erase element by key. If key not found, do nothing.
+       Slot becomes empty if its group still has an empty slot (no probe sequence passes through it),
+       otherwise it becomes a tombstone. */
+    void erase(const KeyType& key) {
+        size_t position = find_position(key, hash_key(key));
+        if (position != capacity()) {
+            erase_at(position);
+        }
+    }
+
+    // Return iterator for an element by key. Returns end() if key not found.
+    iterator find(const KeyType& key) {
+        return iterator(this, find_position(key, hash_key(key)));
+    }
+
+    // Return const_iterator for an element by key. Returns end() if key not found.
+    const_iterator find(const KeyType& key) const {
+        return const_iterator(this, find_position(key, hash_key(key)));
+    }
+
+    size_t size() const {
+        return current_size_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Clear the hashtable
+       Complexity is linear from capacity. */
+    void clear() {
+        destroy_elements();
+        init(FlatHashMap::MIN_NUM_OF_GROUPS);
+    }
+
+    Hash hash_function() const {
+        return hasher_;
+    }
+
+    // Returns an iterator which points to first element.
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    // Returns an iterator which points after last slot.
+    iterator end() {
+        return iterator(this, capacity());
+    }
+
+    // Returns an iterator which points to first element.
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    // Returns an iterator which points after last slot.
+    const_iterator end() const {
+        return const_iterator(this, capacity());
+    }
+
+    /* Return a value by key.
+       If key not found, creates new element in hashtable with default value. */
+    ValueType& operator[](const KeyType& key) {
+        return subscript_key(key);
+    }
+
+    ValueType& operator[](KeyType&& key) {
+        return subscript_key(std::move(key));
+    }
+
+    /* Return a value by key.
+       If key not found, throws std::out_of_range. */
+    const ValueType& at(const KeyType& key) const {
+        size_t position = find_position(key, hash_key(key));
+        if (position == capacity()) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return slots_[position].value.second;
+    }
+
+    /* Iterator for the hash map
+       Contains pointer to the FlatHashMap object and index of the slot.
+       Always points to a full slot, or to capacity() for end. */
+    class iterator {
+      public:
+        iterator() {}
+
+        iterator(FlatHashMap *outer, size_t position = 0): outer(outer), position(position) {
+            find_full_slot();
+        }
+
+        iterator operator++() {
+            position++;
+            find_full_slot();
+            return (*this);
+        }
+
+        iterator operator++(int) {
+            iterator result = (*this);
+            ++(*this);
+            return result;
+        }
+
+        std::pair<const KeyType, ValueType>& operator*() const {
+            return outer->slots_[position].value;
+        }
+
+        std::pair<const KeyType, ValueType>* operator->() const {
+            return &outer->slots_[position].value;
+        }
+
+        bool operator==(const iterator& other) const {
+            return std::tie(position, outer) == std::tie(other.position, other.outer);
+        }
+
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+      private:
+        // Moves iterator to next full slot (or to end).
+        void find_full_slot() {
+            while (position < outer->capacity() && !outer->is_full(position)) {
+                position++;
+            }
+        }
+
+      private:
+        FlatHashMap *outer = nullptr;
+        size_t position;
+    };
+
+    /* Const iterator for the hash map
+       Contains pointer to the FlatHashMap object and index of the slot.
+       Always points to a full slot, or to capacity() for end. */
+    class const_iterator {
+      public:
+        const_iterator() {}
+
+        const_iterator(const FlatHashMap *outer, size_t position = 0): outer(outer), position(position) {
+            find_full_slot();
+        }
+
+        const_iterator operator++() {
+            position++;
+            find_full_slot();
+            return (*this);
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = (*this);
+            ++(*this);
+            return result;
+        }
+
+        const std::pair<const KeyType, ValueType>& operator*() const {
+            return outer->slots_[position].value;
+        }
+
+        const std::pair<const KeyType, ValueType>* operator->() const {
+            return &outer->slots_[position].value;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return std::tie(position, outer) == std::tie(other.position, other.outer);
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+      private:
+        // Moves iterator to next full slot (or to end).
+        void find_full_slot() {
+            while (position < outer->capacity() && !outer->is_full(position)) {
+                position++;
+            }
+        }
+
+      private:
+        const FlatHashMap *outer = nullptr;
+        size_t position;
+    };
+
+  private:
+    // Control byte values. Full slots store the 7-bit fingerprint, which is never negative.
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    // 16 control bytes, aligned so that a group is loaded with one instruction.
+    struct alignas(16) Group {
+        int8_t ctrl[16];
+
+        // Bitmask of slots whose control byte equals value.
+        uint32_t match(int8_t value) const {
+#if defined(__SSE2__)
+            __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < 16; ++i) {
+                mask |= static_cast<uint32_t>(ctrl[i] == value) << i;
+            }
+            return mask;
+#endif
+        }
+
+        // Bitmask of slots which are empty or deleted (their control byte has the sign bit set).
+        uint32_t match_free() const {
+#if defined(__SSE2__)
+            __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+            return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < 16; ++i) {
+                mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+            }
+            return mask;
+#endif
+        }
+    };
+
+    using Slot = MapSlot<KeyType, ValueType>;
+
+    /* Mixes the user hash, so that identity hashes of integers spread over groups.
+       High bits choose the group, low 7 bits are the fingerprint. */
+    size_t hash_key(const KeyType& key) const {
+        uint64_t hash = static_cast<uint64_t>(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+
+    static int8_t fingerprint(size_t hash) {
+        return static_cast<int8_t>(hash & 0x7F);
+    }
+
+    size_t capacity() const {
+        return groups_.size() * FlatHashMap::GROUP_SIZE;
+    }
+
+    bool is_full(size_t position) const {
+        return groups_[position / FlatHashMap::GROUP_SIZE].ctrl[position % FlatHashMap::GROUP_SIZE] >= 0;
+    }
+
+    bool is_deleted(size_t position) const {
+        return groups_[position / FlatHashMap::GROUP_SIZE].ctrl[position % FlatHashMap::GROUP_SIZE] == DELETED;
+    }
+
+    void set_ctrl(size_t position, int8_t value) {
+        groups_[position / FlatHashMap::GROUP_SIZE].ctrl[position % FlatHashMap::GROUP_SIZE] = value;
+    }
+
+    // Index of the lowest set bit, mask is not zero.
+    static unsigned lowest_bit(uint32_t mask) {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+        unsigned bit = 0;
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+    /* Allocates num_of_groups empty groups (must be a power of two).
+       Up to 7/8 of the slots may be used before the table grows. */
+    void init(size_t num_of_groups) {
+        groups_ = empty_groups(num_of_groups);
+        slots_.reset(new Slot[capacity()]);
+        current_size_ = 0;
+        growth_left_ = capacity() - capacity() / 8;
+    }
+
+    static std::vector<Group> empty_groups(size_t num_of_groups) {
+        std::vector<Group> groups(num_of_groups);
+        for (auto& group : groups) {
+            std::fill(group.ctrl, group.ctrl + FlatHashMap::GROUP_SIZE, EMPTY);
+        }
+        return groups;
+    }
+
+    void destroy_elements() {
+        for (size_t i = 0; i < capacity(); ++i) {
+            if (is_full(i)) {
+                slots_[i].destroy();
+            }
+        }
+    }
+
+    /* Returns position of the key or capacity() if key not found.
+       Groups are visited with triangular probing, which covers all groups for power of two sizes.
+       Probing stops at the first group with an empty slot. */
+    size_t find_position(const KeyType& key, size_t hash) const {
+        size_t mask = groups_.size() - 1;
+        size_t group = (hash >> 7) & mask;
+        int8_t h2 = fingerprint(hash);
+        for (size_t step = 1; ; ++step) {
+            const Group& g = groups_[group];
+            for (uint32_t match = g.match(h2); match != 0; match &= match - 1) {
+                size_t position = group * FlatHashMap::GROUP_SIZE + lowest_bit(match);
+                if (slots_[position].value.first == key) {
+                    return position;
+                }
+            }
+            if (g.match(EMPTY) != 0 || step > groups_.size()) {
+                return capacity();
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    // Returns first empty or deleted slot on the probe sequence of hash.
+    size_t find_free_position(size_t hash) const {
+        size_t mask = groups_.size() - 1;
+        size_t group = (hash >> 7) & mask;
+        for (size_t step = 1; ; ++step) {
+            uint32_t free = groups_[group].match_free();
+            if (free != 0) {
+                return group * FlatHashMap::GROUP_SIZE + lowest_bit(free);
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    // operator[] for a copied or a moved key.
+    template<class K>
+    ValueType& subscript_key(K&& key) {
+        size_t hash = hash_key(key);
+        size_t position = find_position(key, hash);
+        if (position == capacity()) {
+            position = prepare_insert(hash);
+            slots_[position].construct(std::forward<K>(key), ValueType());
+            publish_insert(position, hash);
+        }
+        return slots_[position].value.second;
+    }
+
+    /* Finds a free slot for a new element with given hash (key must be absent), growing the table
+       if needed. Caller constructs the element in slots_[position], then calls publish_insert(),
+       so a throwing constructor leaves the slot free and the size unchanged. */
+    size_t prepare_insert(size_t hash) {
+        size_t position = find_free_position(hash);
+        if (growth_left_ == 0 && !is_deleted(position)) {
+            rebuild();
+            position = find_free_position(hash);
+        }
+        return position;
+    }
+
+    // Marks the slot found by prepare_insert() full, its element is constructed.
+    void publish_insert(size_t position, size_t hash) {
+        if (!is_deleted(position)) {
+            growth_left_--;
+        }
+        set_ctrl(position, fingerprint(hash));
+        current_size_++;
+    }
+
+    void erase_at(size_t position) {
+        slots_[position].destroy();
+        current_size_--;
+        if (groups_[position / FlatHashMap::GROUP_SIZE].match(EMPTY) != 0) {
+            set_ctrl(position, EMPTY);
+            growth_left_++;
+        } else {
+            set_ctrl(position, DELETED);
+        }
+    }
+
+    /* Stop the world: moves elements into a new table.
+       If most of the used slots are tombstones, capacity stays the same, otherwise it doubles.
+       New groups and slots are allocated before the old ones are touched, so a failed allocation
+       leaves the table as it was. Elements whose move may throw are copied instead (as std::vector
+       does), and a failed copy leaves the table as it was too. If the hash function throws, or the
+       move of an element which can't be copied, the table keeps the elements moved so far and
+       destroys the others. Complexity is O(capacity). */
+    void rebuild() {
+        size_t num_of_groups = groups_.size();
+        if (size() * 16 > capacity() * 7) {
+            num_of_groups *= 2;
+        }
+        std::vector<Group> old_groups = empty_groups(num_of_groups);
+        std::unique_ptr<Slot[]> old_slots(new Slot[num_of_groups * FlatHashMap::GROUP_SIZE]);
+        old_groups.swap(groups_);
+        old_slots.swap(slots_);
+        size_t old_growth_left = growth_left_;
+        growth_left_ = capacity() - capacity() / 8 - size();
+        size_t old_capacity = old_groups.size() * FlatHashMap::GROUP_SIZE;
+        auto is_old_full = [&old_groups](size_t i) {
+            return old_groups[i / FlatHashMap::GROUP_SIZE].ctrl[i % FlatHashMap::GROUP_SIZE] >= 0;
+        };
+        size_t i = 0;
+        size_t moved = 0;
+        try {
+            for (; i < old_capacity; ++i) {
+                if (is_old_full(i)) {
+                    size_t hash = hash_key(old_slots[i].value.first);
+                    size_t position = find_free_position(hash);
+                    slots_[position].relocate_from(old_slots[i]);
+                    set_ctrl(position, fingerprint(hash));
+                    moved++;
+                }
+            }
+        } catch (...) {
+            if (Slot::RELOCATE_COPIES) {
+                destroy_elements();
+                old_groups.swap(groups_);
+                old_slots.swap(slots_);
+                growth_left_ = old_growth_left;
+            } else {
+                for (; i < old_capacity; ++i) {
+                    if (is_old_full(i)) {
+                        old_slots[i].destroy();
+                    }
+                }
+                current_size_ = moved;
+                growth_left_ = capacity() - capacity() / 8 - moved;
+            }
+            throw;
+        }
+        if (Slot::RELOCATE_COPIES) {
+            for (i = 0; i < old_capacity; ++i) {
+                if (is_old_full(i)) {
+                    old_slots[i].destroy();
+                }
+            }
+        }
+    }
+
+  private:
+    Hash hasher_;
+    std::vector<Group> groups_;
+    std::unique_ptr<Slot[]> slots_;
+
+    size_t current_size_ = 0;
+    // Number of empty slots which may still be filled before rebuild.
+    size_t growth_left_ = 0;
+};
+
+template<class KeyType, class ValueType, class Hash>
+constexpr size_t FlatHashMap<KeyType, ValueType, Hash>::GROUP_SIZE = 16;
+
+template<class KeyType, class ValueType, class Hash>
+constexpr size_t FlatHashMap<KeyType, ValueType, Hash>::MIN_NUM_OF_GROUPS = 1;
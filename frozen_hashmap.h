@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "capacity_policy.h"
+
+/* Read-only hash table over a minimal perfect hash of its keys (CHD: hash, displace).
+   n elements lie in a dense array of n slots, the slot of a key is computed, not searched:
+   keys are spread into buckets of about BUCKET_SIZE keys, and every bucket has a pilot
+   which places all of its keys into free slots. Pilots are chosen at build time,
+   the biggest buckets first, by trying 0, 1, 2, ... until the keys of the bucket
+   fall into distinct free slots. A bucket of one key stores its slot in the pilot directly.
+   A lookup is one hash, one pilot, one slot and one key comparison.
+   Build is expected O(n) time, the pilots take 32 / BUCKET_SIZE bits per key.
+   Hash must not give equal values to different keys: such keys can't be separated,
+   and the build throws std::invalid_argument. If all 2^31 pilots of some bucket fail
+   (not expected from a good Hash), the build throws std::runtime_error. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+         class KeyEqual = std::equal_to<KeyType>>
+class FrozenHashMap {
+  public:
+    using value_type = std::pair<KeyType, ValueType>;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    // Average number of keys in a bucket.
+    static const size_t BUCKET_SIZE;
+
+    explicit FrozenHashMap(const Hash& hash_function = Hash(), const KeyEqual& key_equal = KeyEqual()):
+            hasher_(hash_function), key_equal_(key_equal) {}
+
+    /* Builds the table from [begin; end), keys must be unique.
+       Throws std::invalid_argument if keys repeat or their hashes do,
+       std::length_error for 2^31 keys or more, and std::runtime_error if no pilot places some bucket. */
+    template<class InputIterator>
+    FrozenHashMap(InputIterator begin, InputIterator end, const Hash& hash_function = Hash(),
+                  const KeyEqual& key_equal = KeyEqual()):
+            hasher_(hash_function), key_equal_(key_equal) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<value_type> elements(begin, end);
+        build(elements);
+        build_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Element of the key, nullptr if key is absent.
+    const value_type* find(const KeyType& key) const {
+        if (elements_.empty()) {
+            return nullptr;
+        }
+        const value_type& element = elements_[slot_of(hasher_(key))];
+        return key_equal_(key, element.first) ? &element : nullptr;
+    }
+
+    // If key not found, throws std::out_of_range.
+    const ValueType& at(const KeyType& key) const {
+        const value_type* element = find(key);
+        if (element == nullptr) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return element->second;
+    }
+
+    size_t count(const KeyType& key) const {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    bool contains(const KeyType& key) const {
+        return find(key) != nullptr;
+    }
+
+    size_t size() const {
+        return elements_.size();
+    }
+
+    bool empty() const {
+        return elements_.empty();
+    }
+
+    // Elements in slot order.
+    const_iterator begin() const {
+        return elements_.begin();
+    }
+
+    const_iterator end() const {
+        return elements_.end();
+    }
+
+    // Memory of the perfect hash (pilots), without the elements.
+    double bits_per_key() const {
+        return elements_.empty() ? 0.0 : 32.0 * pilots_.size() / elements_.size();
+    }
+
+    // Wall time the constructor spent to build the table, including the copy of the elements.
+    double build_seconds() const {
+        return build_seconds_;
+    }
+
+    Hash hash_function() const {
+        return hasher_;
+    }
+
+    KeyEqual key_eq() const {
+        return key_equal_;
+    }
+
+  private:
+    // Pilot with this bit holds the slot of the only key of its bucket.
+    static const uint32_t DIRECT;
+
+    // Finalizer of MurmurHash3: std::hash of integers is the identity, buckets need mixed bits.
+    static uint64_t mix(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    size_t slot_by_pilot(uint64_t mixed, uint32_t pilot) const {
+        return slots_.index(mix(mixed + (uint64_t(pilot) + 1) * 0x9E3779B97F4A7C15ull));
+    }
+
+    size_t slot_of(uint64_t hash) const {
+        uint64_t mixed = mix(hash);
+        uint32_t pilot = pilots_[buckets_.index(mixed)];
+        if (pilot & FrozenHashMap::DIRECT) {
+            return pilot ^ FrozenHashMap::DIRECT;
+        }
+        return slot_by_pilot(mixed, pilot);
+    }
+
+    void build(std::vector<value_type>& elements) {
+        size_t n = elements.size();
+        if (n == 0) {
+            return;
+        }
+        if (n >= FrozenHashMap::DIRECT) {
+            throw std::length_error("FrozenHashMap holds less than 2^31 keys");
+        }
+        size_t num_of_buckets = (n + FrozenHashMap::BUCKET_SIZE - 1) / FrozenHashMap::BUCKET_SIZE;
+        buckets_.reset(num_of_buckets);
+        slots_.reset(n);
+        pilots_.assign(num_of_buckets, 0);
+
+        // Keys sorted by buckets: keys of bucket b are order[first[b]; first[b + 1]).
+        std::vector<uint64_t> mixed(n);
+        std::vector<size_t> first(num_of_buckets + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            mixed[i] = mix(hasher_(elements[i].first));
+            first[buckets_.index(mixed[i]) + 1]++;
+        }
+        size_t max_bucket_size = 0;
+        for (size_t bucket = 0; bucket < num_of_buckets; ++bucket) {
+            max_bucket_size = std::max(max_bucket_size, first[bucket + 1]);
+            first[bucket + 1] += first[bucket];
+        }
+        std::vector<size_t> order(n);
+        {
+            std::vector<size_t> next(first.begin(), first.end() - 1);
+            for (size_t i = 0; i < n; ++i) {
+                order[next[buckets_.index(mixed[i])]++] = i;
+            }
+        }
+        // Buckets from the biggest to the smallest.
+        std::vector<size_t> by_size(num_of_buckets);
+        {
+            std::vector<size_t> next(max_bucket_size + 2, 0);
+            for (size_t bucket = 0; bucket < num_of_buckets; ++bucket) {
+                next[max_bucket_size - (first[bucket + 1] - first[bucket]) + 1]++;
+            }
+            for (size_t size = 1; size < next.size(); ++size) {
+                next[size] += next[size - 1];
+            }
+            for (size_t bucket = 0; bucket < num_of_buckets; ++bucket) {
+                by_size[next[max_bucket_size - (first[bucket + 1] - first[bucket])]++] = bucket;
+            }
+        }
+
+        std::vector<bool> taken(n, false);
+        std::vector<size_t> slot_of_key(n);
+        std::vector<size_t> bucket_slots;
+        size_t next_free = 0;
+        for (size_t bucket : by_size) {
+            size_t bucket_size = first[bucket + 1] - first[bucket];
+            const size_t* keys = &order[first[bucket]];
+            if (bucket_size == 0) {
+                break;
+            }
+            if (bucket_size == 1) {
+                while (taken[next_free]) {
+                    next_free++;
+                }
+                taken[next_free] = true;
+                slot_of_key[keys[0]] = next_free;
+                pilots_[bucket] = static_cast<uint32_t>(next_free) | FrozenHashMap::DIRECT;
+                continue;
+            }
+            check_separable(elements, mixed, keys, bucket_size);
+            for (uint32_t pilot = 0;; ++pilot) {
+                if (pilot == FrozenHashMap::DIRECT) {
+                    throw std::runtime_error("FrozenHashMap: no pilot places a bucket");
+                }
+                bucket_slots.clear();
+                for (size_t k = 0; k < bucket_size; ++k) {
+                    size_t slot = slot_by_pilot(mixed[keys[k]], pilot);
+                    if (taken[slot] || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                        break;
+                    }
+                    bucket_slots.push_back(slot);
+                }
+                if (bucket_slots.size() == bucket_size) {
+                    for (size_t k = 0; k < bucket_size; ++k) {
+                        taken[bucket_slots[k]] = true;
+                        slot_of_key[keys[k]] = bucket_slots[k];
+                    }
+                    pilots_[bucket] = pilot;
+                    break;
+                }
+            }
+        }
+
+        std::vector<size_t> key_of_slot(n);
+        for (size_t i = 0; i < n; ++i) {
+            key_of_slot[slot_of_key[i]] = i;
+        }
+        elements_.reserve(n);
+        for (size_t slot = 0; slot < n; ++slot) {
+            elements_.push_back(std::move(elements[key_of_slot[slot]]));
+        }
+    }
+
+    // Keys with equal mixed hashes get equal slots with every pilot.
+    void check_separable(const std::vector<value_type>& elements, const std::vector<uint64_t>& mixed,
+                         const size_t* keys, size_t bucket_size) const {
+        for (size_t k = 0; k < bucket_size; ++k) {
+            for (size_t j = 0; j < k; ++j) {
+                if (mixed[keys[k]] != mixed[keys[j]]) {
+                    continue;
+                }
+                if (key_equal_(elements[keys[k]].first, elements[keys[j]].first)) {
+                    throw std::invalid_argument("FrozenHashMap: repeated key");
+                }
+                throw std::invalid_argument("FrozenHashMap: different keys with equal hashes");
+            }
+        }
+    }
+
+  private:
+    Hash hasher_;
+    KeyEqual key_equal_;
+    std::vector<value_type> elements_;
+    std::vector<uint32_t> pilots_;
+    // Reduce mixed hashes to buckets and to slots.
+    FastrangeCapacity buckets_;
+    FastrangeCapacity slots_;
+    double build_seconds_ = 0;
+};
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual>
+constexpr size_t FrozenHashMap<KeyType, ValueType, Hash, KeyEqual>::BUCKET_SIZE = 4;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual>
+constexpr uint32_t FrozenHashMap<KeyType, ValueType, Hash, KeyEqual>::DIRECT = uint32_t(1) << 31;
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/* Hash functions for HashMap keys.
+   std::hash of integers is the identity in libstdc++, and strided keys (ids multiple of 1024,
+   aligned pointers) then fall into few cells of a table reduced by a modulo or by low bits.
+   Here integers are mixed by two 64x64 -> 128 bit multiplications, and strings are hashed by
+   a function in the style of wyhash (by Wang Yi): 8 or 16 bytes per multiplication.
+   Every hash takes a seed, SeededHash takes a random one for keys from untrusted input.
+   DefaultHash<KeyType> chooses the function for a key type and is the default Hash of HashMap. */
+
+// Replaces a and b with the low and high halves of the 128 bit product a * b.
+inline void hash_multiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    // __extension__ keeps the GNU 128 bit type quiet under -pedantic.
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 product = static_cast<uint128>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t a_low = a & 0xFFFFFFFFull, a_high = a >> 32;
+    uint64_t b_low = b & 0xFFFFFFFFull, b_high = b >> 32;
+    uint64_t low_low = a_low * b_low, low_high = a_low * b_high;
+    uint64_t high_low = a_high * b_low, high_high = a_high * b_high;
+    uint64_t middle = (low_low >> 32) + (low_high & 0xFFFFFFFFull) + (high_low & 0xFFFFFFFFull);
+    a = (low_low & 0xFFFFFFFFull) | (middle << 32);
+    b = high_high + (low_high >> 32) + (high_low >> 32) + (middle >> 32);
+#endif
+}
+
+// High half of the 128 bit product a * b, also the index of fastrange (FastrangeCapacity).
+inline uint64_t multiply_high(uint64_t a, uint64_t b) {
+    hash_multiply(a, b);
+    return b;
+}
+
+// Halves of a * b folded by xor, the mixing step of all hashes here.
+inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_multiply(a, b);
+    return a ^ b;
+}
+
+// Odd constants with balanced bits (from wyhash), xored into the inputs of hash_mix().
+inline constexpr uint64_t HASH_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                            0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+// Every bit of value changes about half of the bits of the result.
+inline uint64_t hash_integer(uint64_t value, uint64_t seed = 0) {
+    return hash_mix(value ^ seed ^ HASH_SECRET[0], hash_mix(value ^ HASH_SECRET[1], seed ^ HASH_SECRET[2]));
+}
+
+inline uint64_t hash_read8(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t hash_read4(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Seed of hash_bytes_with_state(), mixed once instead of on every call.
+inline uint64_t hash_bytes_state(uint64_t seed) {
+    return seed ^ hash_mix(seed ^ HASH_SECRET[0], HASH_SECRET[1]);
+}
+
+/* Hash of size bytes, seed is mixed by hash_bytes_state(). Up to 16 bytes are read as two
+   (possibly overlapping) words without a loop, longer inputs go by 48 bytes in three
+   independent lanes, then by 16. Values depend on the byte order of the machine. */
+inline uint64_t hash_bytes_with_state(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t shift = (size >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + shift);
+            b = (hash_read4(p + size - 4) << 32) | hash_read4(p + size - 4 - shift);
+        } else if (size > 0) {
+            a = (uint64_t(p[0]) << 16) | (uint64_t(p[size >> 1]) << 8) | p[size - 1];
+        }
+    } else {
+        size_t left = size;
+        if (left > 48) {
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = hash_mix(hash_read8(p) ^ HASH_SECRET[1], hash_read8(p + 8) ^ seed);
+                lane1 = hash_mix(hash_read8(p + 16) ^ HASH_SECRET[2], hash_read8(p + 24) ^ lane1);
+                lane2 = hash_mix(hash_read8(p + 32) ^ HASH_SECRET[3], hash_read8(p + 40) ^ lane2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (left > 16) {
+            seed = hash_mix(hash_read8(p) ^ HASH_SECRET[1], hash_read8(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        a = hash_read8(p + left - 16);
+        b = hash_read8(p + left - 8);
+    }
+    a ^= HASH_SECRET[1];
+    b ^= seed;
+    hash_multiply(a, b);
+    return hash_mix(a ^ HASH_SECRET[0] ^ size, b ^ HASH_SECRET[1]);
+}
+
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+    return hash_bytes_with_state(data, size, hash_bytes_state(seed));
+}
+
+// Integers, enums and pointers, by hash_integer().
+struct IntegerHash {
+    explicit IntegerHash(uint64_t seed = 0): seed_(seed) {}
+
+    template<class T, class = typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value ||
+                                                      std::is_pointer<T>::value>::type>
+    size_t operator()(T key) const {
+        return static_cast<size_t>(hash_integer(to_integer(key), seed_));
+    }
+
+  private:
+    template<class T>
+    static uint64_t to_integer(T* key) {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+    }
+
+    template<class T>
+    static uint64_t to_integer(T key) {
+        return static_cast<uint64_t>(key);
+    }
+
+  private:
+    uint64_t seed_;
+};
+
+/* Transparent hash of strings by hash_bytes(): std::string, std::string_view and const char* keys
+   give the same values, so HashMap<std::string, V, StringHash, std::equal_to<>> accepts
+   std::string_view and const char* in find(), at(), erase(), count() and contains(). */
+struct StringHash {
+    using is_transparent = void;
+
+    explicit StringHash(uint64_t seed = 0): state_(hash_bytes_state(seed)) {}
+
+    size_t operator()(std::string_view key) const {
+        return static_cast<size_t>(hash_bytes_with_state(key.data(), key.size(), state_));
+    }
+
+  private:
+    uint64_t state_;
+};
+
+/* Default Hash of HashMap: IntegerHash for integers, enums and pointers, StringHash
+   for std::string and std::string_view, and std::hash mixed by hash_integer() for other keys,
+   so a weak user specialization of std::hash is still spread over the cells.
+   Specialize it for a key type to change the choice. */
+template<class KeyType, class Enable = void>
+struct DefaultHash {
+    explicit DefaultHash(uint64_t seed = 0): seed_(seed) {}
+
+    size_t operator()(const KeyType& key) const {
+        return static_cast<size_t>(hash_integer(std::hash<KeyType>()(key), seed_));
+    }
+
+  private:
+    uint64_t seed_;
+};
+
+template<class KeyType>
+struct DefaultHash<KeyType, typename std::enable_if<std::is_integral<KeyType>::value || std::is_enum<KeyType>::value ||
+                                                    std::is_pointer<KeyType>::value>::type> : IntegerHash {
+    using IntegerHash::IntegerHash;
+};
+
+template<class Traits, class Allocator>
+struct DefaultHash<std::basic_string<char, Traits, Allocator>> : StringHash {
+    using StringHash::StringHash;
+};
+
+template<>
+struct DefaultHash<std::string_view> : StringHash {
+    using StringHash::StringHash;
+};
+
+// Seed of SeededHash: random, taken once per process.
+inline uint64_t random_hash_seed() {
+    static const uint64_t seed = [] {
+        std::random_device device;
+        return (uint64_t(device()) << 32) ^ device();
+    }();
+    return seed;
+}
+
+/* DefaultHash with the seed of random_hash_seed(): values differ from run to run, so keys chosen
+   to collide (hash flooding) can't be prepared in advance. Don't use it for anything which outlives
+   the process, such as the snapshots of MappedHashMap. */
+template<class KeyType>
+struct SeededHash : DefaultHash<KeyType> {
+    SeededHash(): DefaultHash<KeyType>(random_hash_seed()) {}
+};
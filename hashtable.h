@@ -1,8 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <vector>
 #include <utility>
 #include <stdexcept>
+#include <string>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "capacity_policy.h"
+#include "frozen_hashmap.h"
+#include "hash_functions.h"
+#include "load_factor_policy.h"
+#include "node_pool.h"
+#include "operation_counters.h"
+#include "serialization.h"
+#include "thread_pool.h"
+
+/* Whether HashMap keeps the full hash of the key next to each element.
+   Then rebuild() never calls the hash function again, and lookups compare
+   the stored hash before calling operator== on the key.
+   Integers, enums and pointers are cheaper to rehash and compare than to store,
+   specialize this for other key types to change the choice. */
+template<class KeyType>
+struct StoreHash : std::integral_constant<bool, !std::is_arithmetic<KeyType>::value &&
+                                                !std::is_enum<KeyType>::value &&
+                                                !std::is_pointer<KeyType>::value> {};
+
+/* Element of a HashMap cell: pointer to the node and, if hashes are stored, full hash of the key. */
+template<class Pointer, bool WithHash>
+struct HashMapEntry {
+    HashMapEntry(Pointer node, size_t): node(node) {}
+
+    // False if the stored hash shows the keys differ, true if keys must be compared.
+    bool may_match(size_t) const {
+        return true;
+    }
+
+    template<class Hash>
+    size_t hash(const Hash& hasher) const {
+        return hasher(node->first);
+    }
+
+    Pointer node;
+};
+
+template<class Pointer>
+struct HashMapEntry<Pointer, true> {
+    HashMapEntry(Pointer node, size_t hash): node(node), full_hash(hash) {}
+
+    bool may_match(size_t hash) const {
+        return full_hash == hash;
+    }
+
+    template<class Hash>
+    size_t hash(const Hash&) const {
+        return full_hash;
+    }
+
+    Pointer node;
+    size_t full_hash;
+};
+
+/* Snapshot of the shape of a HashMap and of its rebuild history, returned by HashMap::stats().
+   During an incremental rebuild cells of both tables are counted. */
+struct HashMapStats {
+    size_t size = 0;
+    size_t num_of_cells = 0;
+    size_t max_bucket_size = 0;
+    // Average size of a non-empty cell, the average of all cells is the load factor.
+    double average_bucket_size = 0;
+    double empty_bucket_ratio = 0;
+    // bucket_size_histogram[k] is the number of cells with k elements, up to max_bucket_size.
+    std::vector<size_t> bucket_size_histogram;
+    /* rebuild() calls which made the table bigger or smaller, and their wall time in total.
+       In incremental mode the cells moved later by inserts and erases are not timed. */
+    size_t num_of_grows = 0;
+    size_t num_of_shrinks = 0;
+    double rebuild_seconds = 0;
+    // Memory of the cells (array and entry buffers of all tables) and of the node pool.
+    size_t bucket_bytes = 0;
+    size_t node_bytes = 0;
+};
 
 /* General class for hashtable with closed addressing.
    Basic interface is:
@@ -11,140 +98,387 @@
       3. Erase an element by key.
    Key must be unique.
    Complexity is amortized O(1) for a query.
-   Memory is linear from number of elements inside the table. */
-template<class KeyType, class ValueType, class Hash = std::hash<KeyType> >
-class HashMap {
+   Memory is linear from number of elements inside the table.
+   Elements live in nodes taken from a pool owned by the table,
+   a node never moves until its element is erased.
+   CapacityPolicy chooses allowed capacities and reduces a hash to a cell (see capacity_policy.h).
+   Cells keep the full hash of every key if StoreHash<KeyType> is true.
+   With set_incremental_rebuild(true) the table is rebuilt incrementally: the old table is kept
+   next to the new one, and every insert and erase moves at least MIGRATION_STEP cells of it,
+   more if the load factor policy brings the next rebuild closer.
+   The cells of the next bigger table are also constructed a few at a time ahead of the growth.
+   With set_parallel_rebuild(true) a stop-the-world rebuild of at least PARALLEL_REBUILD_SIZE
+   elements is split between the threads of the table's pool, ThreadPool::instance() unless
+   set_thread_pool() gives another one.
+   Table grows and shrinks by LoadFactorPolicy (see load_factor_policy.h), its defaults are taken
+   from LoadFactorDefaults and may be changed at runtime by set_load_factor_policy().
+   Instrumentation counts hash calls, key comparisons, probed entries and node allocations
+   (see operation_counters.h), the default NoOperationCounters compiles to nothing
+   and takes no space in the table.
+   Keys are hashed by DefaultHash (see hash_functions.h) unless Hash is given: integers are mixed,
+   not taken as they are like std::hash does, so strided keys don't gather in few cells.
+   Keys are compared by KeyEqual. Nodes and cells are allocated by Allocator (rebound to each type),
+   pmr::HashMap takes a std::pmr::memory_resource. The allocator is never propagated on copy
+   or move assignment, elements are copied or moved one by one if allocators differ. */
+template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType>,
+         class KeyEqual = std::equal_to<KeyType>,
+         class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+         class CapacityPolicy = ModuloCapacity, class LoadFactorDefaults = DefaultLoadFactor,
+         class Instrumentation = NoOperationCounters>
+class HashMap : private InstrumentationStorage<Instrumentation> {
   public:
     // Minimal number of cells. Also used for initialization.
     static const size_t MIN_NUM_OF_CELLS;
-    static const size_t SCALE;
+    // Least number of old cells moved by each insert or erase during an incremental rebuild.
+    static const size_t MIGRATION_STEP;
+    /* Distance in keys between the prefetch stages of find_many().
+       Initialized here: it sizes the arrays of find_many_positions(). */
+    static constexpr size_t FIND_MANY_WINDOW = 8;
+    // Smallest range which insert(begin, end) inserts in parallel.
+    static const size_t PARALLEL_BUILD_SIZE;
+    // Smallest size which a parallel rebuild is used for, smaller tables are rebuilt by one thread.
+    static const size_t PARALLEL_REBUILD_SIZE;
+    // Number of cells in one task of parallel_for_each(), parallel_reduce() and parallel_count_if().
+    static const size_t PARALLEL_SCAN_CHUNK;
+    // First bytes of a serialized table, and the version of the format.
+    static const uint64_t SERIALIZATION_MAGIC;
+    static const uint32_t SERIALIZATION_VERSION;
+    // Largest number of elements deserialize() presizes for when the stream can't tell its size.
+    static const size_t DESERIALIZE_PRESIZE_LIMIT;
 
-    using pair_ptr = std::unique_ptr<std::pair<const KeyType, ValueType>>;
+    using value_type = std::pair<const KeyType, ValueType>;
+    using allocator_type = Allocator;
+    using pair_ptr = value_type*;
+    using entry = HashMapEntry<pair_ptr, StoreHash<KeyType>::value>;
+    using cell_type = std::vector<entry, typename std::allocator_traits<Allocator>::template rebind_alloc<entry>>;
+    using table_type = std::vector<cell_type, typename std::allocator_traits<Allocator>::template rebind_alloc<cell_type>>;
 
     class iterator;
     class const_iterator;
 
-    HashMap(): hasher_() {
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-    }
+    HashMap(): HashMap(Hash()) {}
+
+    explicit HashMap(const Allocator& allocator): HashMap(Hash(), KeyEqual(), allocator) {}
     
-    HashMap(const Hash& hash_function): hasher_(hash_function) {
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
+    explicit HashMap(const Hash& hash_function, const KeyEqual& key_equal = KeyEqual(),
+                     const Allocator& allocator = Allocator()):
+                     hasher_(hash_function), key_equal_(key_equal), table_(allocator), pool_(allocator),
+                     old_table_(allocator), spare_table_(allocator) {
+        init_table();
     }
     
     template<class ForwardIterator>
-    HashMap(ForwardIterator begin, ForwardIterator end) {
-        hasher_ = Hash();
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-        while (begin != end) {
-            insert(*begin);
-            ++begin;
-        }
+    HashMap(ForwardIterator begin, ForwardIterator end, const Hash& hash_function = Hash(),
+            const KeyEqual& key_equal = KeyEqual(), const Allocator& allocator = Allocator()):
+            HashMap(hash_function, key_equal, allocator) {
+        insert(begin, end);
     }
     
-    template<class ForwardIterator>
-    HashMap(ForwardIterator begin, ForwardIterator end, const Hash& hash_function) {
-        hasher_ = hash_function;
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-        while (begin != end) {
-            insert(*begin);
-            ++begin;
-        }
+    HashMap(std::initializer_list<std::pair<KeyType, ValueType>> initializer_list, const Hash& hash_function = Hash(),
+            const KeyEqual& key_equal = KeyEqual(), const Allocator& allocator = Allocator()):
+            HashMap(hash_function, key_equal, allocator) {
+        insert(initializer_list.begin(), initializer_list.end());
     }
     
-    HashMap(std::initializer_list<std::pair<KeyType, ValueType>> initializer_list, Hash hash_function = Hash()) {
-        hasher_ = hash_function;
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-        for (auto it = initializer_list.begin(); it != initializer_list.end(); ++it) {
-            insert(*it);
+    HashMap(const HashMap& other):
+            HashMap(other, std::allocator_traits<Allocator>::select_on_container_copy_construction(
+                               other.get_allocator())) {}
+
+    HashMap(const HashMap& other, const Allocator& allocator):
+            HashMap(other.hasher_, other.key_equal_, allocator) {
+        copy_settings(other);
+        for (const auto &element : other) {
+            insert(element);
         }
     }
     
-    HashMap(const HashMap& other): hasher_(other.hasher_) {
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-        for (auto element : other) {
-            insert(element);
+    HashMap(HashMap&& other): HashMap(other.hasher_, other.key_equal_, other.get_allocator()) {
+        swap(other);
+    }
+
+    // Takes the nodes of other if allocators are equal, otherwise moves the values one by one.
+    HashMap(HashMap&& other, const Allocator& allocator): HashMap(other.hasher_, other.key_equal_, allocator) {
+        if (get_allocator() == other.get_allocator()) {
+            swap(other);
+            return;
+        }
+        copy_settings(other);
+        for (auto &element : other) {
+            try_emplace(element.first, std::move(element.second));
         }
     }
-    
+
     HashMap& operator=(const HashMap& other) {
-        hasher_ = other.hasher_;
-        table_.resize(HashMap::MIN_NUM_OF_CELLS);
-        current_capacity_ = HashMap::MIN_NUM_OF_CELLS;
-        for (auto element : other) {
-            insert(element);
+        if (this != &other) {
+            HashMap copy(other, get_allocator());
+            swap(copy);
         }
         return *this;
     }
 
-    HashMap& operator=(const HashMap&& other) {
-        hasher_ = std::move(other.hasher_);
-        table_ = std::move(other.table_);
-        current_size_ = other.size();
-        current_capacity_ = other.current_capacity_;
+    HashMap& operator=(HashMap&& other) {
+        if (get_allocator() == other.get_allocator()) {
+            swap(other);
+        } else {
+            HashMap moved(std::move(other), get_allocator());
+            swap(moved);
+        }
         return *this;
     }
+
+    ~HashMap() {
+        destroy_nodes();
+    }
+
+    /* Nodes are swapped together with their pools, so pointers to elements stay valid.
+       Allocators must be equal unless they propagate on swap. */
+    void swap(HashMap& other) {
+        std::swap(hasher_, other.hasher_);
+        std::swap(key_equal_, other.key_equal_);
+        table_.swap(other.table_);
+        pool_.swap(other.pool_);
+        std::swap(current_size_, other.current_size_);
+        std::swap(current_capacity_, other.current_capacity_);
+        std::swap(capacity_policy_, other.capacity_policy_);
+        std::swap(load_policy_, other.load_policy_);
+        std::swap(grow_threshold_, other.grow_threshold_);
+        std::swap(shrink_threshold_, other.shrink_threshold_);
+        std::swap(min_capacity_, other.min_capacity_);
+        old_table_.swap(other.old_table_);
+        std::swap(old_capacity_policy_, other.old_capacity_policy_);
+        spare_table_.swap(other.spare_table_);
+        std::swap(incremental_rebuild_, other.incremental_rebuild_);
+        std::swap(parallel_rebuild_, other.parallel_rebuild_);
+        std::swap(thread_pool_, other.thread_pool_);
+        std::swap(migration_step_, other.migration_step_);
+        std::swap(num_of_grows_, other.num_of_grows_);
+        std::swap(num_of_shrinks_, other.num_of_shrinks_);
+        std::swap(rebuild_seconds_, other.rebuild_seconds_);
+        std::swap(this->counters(), other.counters());
+    }
+
+    /* Turns incremental rebuild on or off.
+       When it is on, rebuild does not move all elements at once: a new table is allocated,
+       and following inserts and erases move a few cells of the old one each.
+       Turning it off finishes the current migration. */
+    void set_incremental_rebuild(bool incremental) {
+        if (!incremental) {
+            finish_migration();
+            table_type(spare_table_.get_allocator()).swap(spare_table_);
+        }
+        incremental_rebuild_ = incremental;
+    }
+
+    bool incremental_rebuild() const {
+        return incremental_rebuild_;
+    }
+
+    /* Turns parallel rebuild on or off.
+       When it is on, a rebuild of a table with at least PARALLEL_REBUILD_SIZE elements
+       is done by all threads of thread_pool(): every thread takes a range of old cells
+       and sorts their entries by ranges of new cells, then every thread fills its own range
+       of new cells. Used only if the allocator is stateless, and not in incremental mode,
+       where a rebuild moves nothing at once. */
+    void set_parallel_rebuild(bool parallel) {
+        parallel_rebuild_ = parallel;
+    }
+
+    bool parallel_rebuild() const {
+        return parallel_rebuild_;
+    }
+
+    /* Sets the pool of the parallel passes: bulk insert, parallel rebuild and parallel scans.
+       The pool must outlive the table or be replaced first, nullptr goes back to ThreadPool::instance().
+       A pool of one thread makes all the passes serial. Copies of the table share the pool. */
+    void set_thread_pool(ThreadPool* pool) {
+        thread_pool_ = pool;
+    }
+
+    ThreadPool& thread_pool() const {
+        return thread_pool_ != nullptr ? *thread_pool_ : ThreadPool::instance();
+    }
+
+    const LoadFactorPolicy& load_factor_policy() const {
+        return load_policy_;
+    }
+
+    /* Replaces load factor settings and rebuilds the table if its size is out of the new bounds.
+       Throws std::invalid_argument if settings break the hysteresis gap (see LoadFactorPolicy). */
+    void set_load_factor_policy(const LoadFactorPolicy& policy) {
+        policy.validate();
+        load_policy_ = policy;
+        update_thresholds();
+        check_rebuild();
+    }
     
-    /* Insert an element into the hashtable by its key.
+    /* Insert an element into the hashtable by its key. If key is already present, do nothing.
+       Returns iterator to the element with this key and whether the element was inserted.
        Complexity is linear from cell size, but we assume size is O(1).
-       If size becomes more than capacity, we do stop-the-world rebuild which takes O(total_size) time. */
-    void insert(const std::pair<const KeyType, ValueType> &pair) {
-        size_t hash = hasher_(pair.first) % current_capacity_;
-        for (const auto &p : table_[hash]) {
-            if (p->first == pair.first) {
-                return;
-            }
+       If size becomes more than capacity * max_load_factor, we do stop-the-world rebuild
+       before inserting, which takes O(total_size) time. */
+    std::pair<iterator, bool> insert(const std::pair<const KeyType, ValueType> &pair) {
+        return try_emplace(pair.first, pair.second);
+    }
+
+    // Same as above, but the value is moved into the table.
+    std::pair<iterator, bool> insert(std::pair<const KeyType, ValueType> &&pair) {
+        return try_emplace(pair.first, std::move(pair.second));
+    }
+
+    /* Inserts the elements of [begin; end), an element is skipped if its key is already present
+       in the table or earlier in the range.
+       For forward iterators the table is rebuilt at most once, for the final size.
+       Ranges of at least PARALLEL_BUILD_SIZE elements are inserted by all threads of
+       thread_pool() if the allocator is stateless: elements are hashed in parallel,
+       partitioned by ranges of cells, and every thread fills its own cells with nodes from
+       its own run of the pool, without locks. */
+    template<class InputIterator>
+    void insert(InputIterator begin, InputIterator end) {
+        insert_range(begin, end, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+
+    /* Constructs an element from args and inserts it if its key is absent.
+       The key is not known before the element is constructed, so the node is taken from the pool
+       first and goes back to it if the key is present. Use try_emplace() to avoid that. */
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        migrate_step();
+        pair_ptr node = create_node(std::forward<Args>(args)...);
+        size_t hash = hash_key(node->first);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(node->first, hash, cell);
+        if (position != cell_at(cell).size()) {
+            pool_.destroy(node);
+            return std::make_pair(iterator(this, cell, position), false);
         }
-        table_[hash].push_back(pair_ptr(new std::pair<const KeyType, ValueType>(pair)));
-        current_size_++;
-        check_rebuild();
+        return std::make_pair(insert_node(node, hash), true);
+    }
+
+    /* If key is absent, inserts an element with the value constructed in place from args,
+       otherwise does nothing and does not touch args.
+       Hashes the key once and scans its cell once. */
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const KeyType& key, Args&&... args) {
+        return try_emplace_key(key, std::forward<Args>(args)...);
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(KeyType&& key, Args&&... args) {
+        return try_emplace_key(std::move(key), std::forward<Args>(args)...);
+    }
+
+    // Inserts an element with the value, or assigns the value to the existing element.
+    template<class Value>
+    std::pair<iterator, bool> insert_or_assign(const KeyType& key, Value&& value) {
+        auto result = try_emplace(key, std::forward<Value>(value));
+        if (!result.second) {
+            result.first->second = std::forward<Value>(value);
+        }
+        return result;
+    }
+
+    template<class Value>
+    std::pair<iterator, bool> insert_or_assign(KeyType&& key, Value&& value) {
+        auto result = try_emplace(std::move(key), std::forward<Value>(value));
+        if (!result.second) {
+            result.first->second = std::forward<Value>(value);
+        }
+        return result;
     }
 
     /* Erase element by key. If key not found, do nothing.
        Complexity is linear from cell size, but we assume size is O(1).
-       If size becomes less then (capacity / 4), stop-the-world and rebuild which takes O(total_size) time. */
-    void erase(KeyType key) {
-        size_t hash = hasher_(key) % current_capacity_;
-        for (size_t i = 0; i < table_[hash].size(); i++) {
-            auto &pair = table_[hash][i];
-            if (pair->first == key) {
-                /* erasing pair from cell */
-                table_[hash].erase(table_[hash].begin() + i);
-                current_size_--;
-                check_rebuild();
-                break;
-            }
-        }
+       If size becomes less then capacity * min_load_factor, stop-the-world and rebuild
+       which takes O(total_size) time. */
+    void erase(const KeyType& key) {
+        erase_key(key);
     }
 
     /* Return iterator for an element by key. Returns end() if key not found.
        Complexity is linear from cell size, but we assume size is O(1). */
-    iterator find(KeyType key) {
-        size_t hash = hasher_(key) % current_capacity_;
-        for (size_t i = 0; i < table_[hash].size(); i++) {
-            if (table_[hash][i]->first == key) {
-                return iterator(this, hash, i);
-            }
-        }
-        return end();
+    iterator find(const KeyType& key) {
+        return find_key(key);
     }
 
     /* Return const_iterator for an element by key. Returns end() if key not found.
        Complexity is linear from cell size, but we assume size is O(1). */
-    const_iterator find(KeyType key) const {
-        size_t hash = hasher_(key) % current_capacity_;
-        for (size_t i = 0; i < table_[hash].size(); i++) {
-            if (table_[hash][i]->first == key) {
-                return const_iterator(this, hash, i);
-            }
-        }
-        return end();
+    const_iterator find(const KeyType& key) const {
+        return find_key(key);
+    }
+
+    /* Finds n keys and writes an iterator for each of them (end() if key is not found) to out,
+       in the order of keys. Returns out after the last write.
+       Lookups overlap their cache misses: a key is hashed and its cell is prefetched,
+       FIND_MANY_WINDOW keys later its entries are prefetched, then its nodes,
+       and only then the key is compared. Pays off when the table does not fit in cache. */
+    template<class Out>
+    Out find_many(const KeyType* keys, size_t n, Out out) {
+        find_many_positions(keys, n, [this, &out](size_t cell, size_t position) {
+            *out++ = position == cell_at(cell).size() ? end() : iterator(this, cell, position);
+        });
+        return out;
+    }
+
+    template<class Out>
+    Out find_many(const KeyType* keys, size_t n, Out out) const {
+        find_many_positions(keys, n, [this, &out](size_t cell, size_t position) {
+            *out++ = position == cell_at(cell).size() ? end() : const_iterator(this, cell, position);
+        });
+        return out;
+    }
+
+    size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    bool contains(const KeyType& key) const {
+        return find_key(key) != end();
+    }
+
+    /* Lookups by any key type K that Hash and KeyEqual accept, if both have is_transparent
+       member type (as StringHash and std::equal_to<> do). Hash of K must be equal to hash of KeyType
+       for equal keys. Then no KeyType is constructed, e.g. HashMap<std::string, V, StringHash,
+       std::equal_to<>> is searched by std::string_view or const char* without allocations. */
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    void erase(const K& key) {
+        erase_key(key);
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    iterator find(const K& key) {
+        return find_key(key);
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    const_iterator find(const K& key) const {
+        return find_key(key);
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    size_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    bool contains(const K& key) const {
+        return find_key(key) != end();
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    ValueType& at(const K& key) {
+        return at_key(key);
+    }
+
+    template<class K, class H = Hash, class E = KeyEqual,
+             class = typename H::is_transparent, class = typename E::is_transparent>
+    const ValueType& at(const K& key) const {
+        return at_key(key);
     }
 
     size_t size() const {
@@ -158,17 +492,261 @@ class HashMap {
     /* Clear the hashtable
        Complexity is linear from all the elements. */
     void clear() {
-        for (size_t i = 0; i < current_capacity_; i++) {
-            table_[i].clear();
-        }
+        destroy_nodes();
+        table_.clear();
+        old_table_.clear();
+        spare_table_.clear();
+        pool_.clear();
         current_size_ = 0;
-        rebuild();
+        init_table();
     }
 
     Hash hash_function() const {
         return hasher_;
     }
 
+    KeyEqual key_eq() const {
+        return key_equal_;
+    }
+
+    Allocator get_allocator() const {
+        return pool_.get_allocator();
+    }
+
+    /* Prepares the table for count elements, so that inserting them does not rebuild it.
+       Same as rehash(count / max_load_factor()). */
+    void reserve(size_t count) {
+        rehash(static_cast<size_t>(std::ceil(count / double(load_policy_.max_load_factor))));
+    }
+
+    /* Rebuilds the table with at least count cells (and enough cells for the current size).
+       count also becomes the lower bound for shrinking on erase, rehash(0) removes the bound.
+       Complexity is O(size + capacity). */
+    void rehash(size_t count) {
+        min_capacity_ = count;
+        double fit = std::ceil(size() / double(load_policy_.max_load_factor));
+        size_t new_capacity = CapacityPolicy::round_up(
+            std::max({HashMap::MIN_NUM_OF_CELLS, count, static_cast<size_t>(fit)}));
+        if (new_capacity != current_capacity_) {
+            rebuild(new_capacity);
+        }
+    }
+
+    // Number of cells.
+    size_t bucket_count() const {
+        return current_capacity_;
+    }
+
+    /* Number of elements in the cell.
+       During an incremental rebuild elements which are still in the old table are not counted. */
+    size_t bucket_size(size_t cell) const {
+        return table_[cell].size();
+    }
+
+    // Cell of the key, in [0; bucket_count()).
+    size_t bucket(const KeyType& key) const {
+        return capacity_policy_.index(hash_key(key));
+    }
+
+    float load_factor() const {
+        return static_cast<float>(size()) / static_cast<float>(bucket_count());
+    }
+
+    float max_load_factor() const {
+        return load_policy_.max_load_factor;
+    }
+
+    /* Sets max load factor and rebuilds the table if needed.
+       Min load factor is lowered if needed to keep the hysteresis gap (see LoadFactorPolicy). */
+    void max_load_factor(float max_load_factor) {
+        LoadFactorPolicy policy = load_policy_;
+        policy.max_load_factor = max_load_factor;
+        float growth = policy.growth_factor;
+        policy.min_load_factor = std::min(policy.min_load_factor, max_load_factor / (growth * growth));
+        set_load_factor_policy(policy);
+    }
+
+    /* Collects HashMapStats. Costs O(capacity) when called and nothing otherwise:
+       the table only counts its rebuilds and times them, nothing is added to lookups and inserts.
+       Reads the table like find() does, so a thread which samples it must be synchronized
+       with the writers, as for any other const method. */
+    HashMapStats stats() const {
+        HashMapStats stats;
+        stats.size = size();
+        stats.num_of_cells = num_of_cells();
+        size_t non_empty = 0;
+        size_t entry_capacity = 0;
+        for (size_t cell = 0; cell < num_of_cells(); ++cell) {
+            const cell_type& current = cell_at(cell);
+            if (current.size() >= stats.bucket_size_histogram.size()) {
+                stats.bucket_size_histogram.resize(current.size() + 1, 0);
+            }
+            stats.bucket_size_histogram[current.size()]++;
+            non_empty += current.empty() ? 0 : 1;
+            entry_capacity += current.capacity();
+        }
+        stats.max_bucket_size = stats.bucket_size_histogram.size() - 1;
+        if (non_empty > 0) {
+            stats.average_bucket_size = double(stats.size) / non_empty;
+        }
+        stats.empty_bucket_ratio = 1.0 - double(non_empty) / stats.num_of_cells;
+        stats.num_of_grows = num_of_grows_;
+        stats.num_of_shrinks = num_of_shrinks_;
+        stats.rebuild_seconds = rebuild_seconds_;
+        size_t cells = table_.capacity() + old_table_.capacity() + spare_table_.capacity();
+        stats.bucket_bytes = cells * sizeof(cell_type) + entry_capacity * sizeof(entry);
+        stats.node_bytes = pool_.allocated_bytes();
+        return stats;
+    }
+
+    /* Counters of the Instrumentation policy, e.g. with OperationCounters:
+          map.operation_counters().reset();
+          map[key];
+          assert(map.operation_counters().hashes == 1); */
+    Instrumentation& operation_counters() {
+        return this->counters();
+    }
+
+    const Instrumentation& operation_counters() const {
+        return this->counters();
+    }
+
+    /* Calls fn(element) for every element, from all threads of thread_pool() at once.
+       Cells are split into chunks of PARALLEL_SCAN_CHUNK, threads take the next chunk when they are
+       done with theirs, so slow chunks do not hold the others. fn may change the mapped values
+       but not the table. If fn throws, the first exception is rethrown after all threads stop. */
+    template<class Function>
+    void parallel_for_each(Function fn) {
+        scan_chunks([this, &fn](size_t, size_t first, size_t last) {
+            for (size_t cell = first; cell < last; ++cell) {
+                for (auto& ptr : cell_at(cell)) {
+                    fn(*ptr.node);
+                }
+            }
+        });
+    }
+
+    template<class Function>
+    void parallel_for_each(Function fn) const {
+        scan_chunks([this, &fn](size_t, size_t first, size_t last) {
+            for (size_t cell = first; cell < last; ++cell) {
+                for (const auto& ptr : cell_at(cell)) {
+                    fn(static_cast<const value_type&>(*ptr.node));
+                }
+            }
+        });
+    }
+
+    /* Returns reduce(...reduce(init, map(e1))..., map(en)) over all elements in parallel,
+       in some order and grouping: reduce must be associative and commutative.
+       Every chunk is reduced by one thread, then the results of the chunks are reduced in order. */
+    template<class T, class Map, class Reduce>
+    T parallel_reduce(T init, Map map, Reduce reduce) const {
+        std::vector<std::optional<T>> partial(num_of_scan_chunks());
+        scan_chunks([this, &map, &reduce, &partial](size_t chunk, size_t first, size_t last) {
+            std::optional<T> result;
+            for (size_t cell = first; cell < last; ++cell) {
+                for (const auto& ptr : cell_at(cell)) {
+                    if (result) {
+                        result = reduce(std::move(*result), map(static_cast<const value_type&>(*ptr.node)));
+                    } else {
+                        result.emplace(map(static_cast<const value_type&>(*ptr.node)));
+                    }
+                }
+            }
+            partial[chunk] = std::move(result);
+        });
+        for (auto& result : partial) {
+            if (result) {
+                init = reduce(std::move(init), std::move(*result));
+            }
+        }
+        return init;
+    }
+
+    // Number of elements satisfying pred, counted in parallel.
+    template<class Predicate>
+    size_t parallel_count_if(Predicate pred) const {
+        return parallel_reduce(size_t(0), [&pred](const value_type& element) -> size_t {
+            return pred(element) ? 1 : 0;
+        }, std::plus<size_t>());
+    }
+
+    /* Copies the elements into a FrozenHashMap, a read-only table over a minimal perfect hash
+       of the current keys (see frozen_hashmap.h). Later changes of this table are not seen there.
+       Throws what the FrozenHashMap build throws, e.g. std::invalid_argument if different keys have equal hashes. */
+    FrozenHashMap<KeyType, ValueType, Hash, KeyEqual> freeze() const {
+        return FrozenHashMap<KeyType, ValueType, Hash, KeyEqual>(begin(), end(), hasher_, key_equal_);
+    }
+
+    /* Writes the number of elements and the elements, cell after cell, to a chunked stream
+       (see serialization.h). Keys and values are written by Serializer<KeyType> and Serializer<ValueType>.
+       Settings of the table are not written. Throws std::runtime_error if the stream fails. */
+    void serialize(std::ostream& out) const {
+        StreamWriter writer(out);
+        uint64_t header[2] = {HashMap::SERIALIZATION_MAGIC, HashMap::SERIALIZATION_VERSION};
+        uint64_t count = size();
+        writer.write(header, sizeof(header));
+        writer.write(&count, sizeof(count));
+        for (size_t cell = 0; cell < num_of_cells(); ++cell) {
+            for (const auto& ptr : cell_at(cell)) {
+                Serializer<KeyType>::write(writer, ptr.node->first);
+                Serializer<ValueType>::write(writer, ptr.node->second);
+            }
+        }
+        writer.finish();
+    }
+
+    /* Replaces the contents with a table written by serialize(), settings are kept.
+       The table is sized from the header once, then every element is put straight
+       into its cell: no incremental migration while loading. The count of the header is trusted
+       only as far as the bytes left in the stream may hold that many elements (see SerializedMinSize),
+       so a corrupted count can't allocate more than the stream holds. If the stream can't tell
+       its size, the table is presized for at most DESERIALIZE_PRESIZE_LIMIT elements and then
+       grows eight times at once while the elements arrive.
+       Throws std::runtime_error if the stream is corrupted or the table can't be allocated,
+       the table is unchanged then. */
+    void deserialize(std::istream& in) {
+        StreamReader reader(in);
+        uint64_t header[2] = {0, 0};
+        uint64_t count = 0;
+        reader.read(header, sizeof(header));
+        if (header[0] != HashMap::SERIALIZATION_MAGIC || header[1] != HashMap::SERIALIZATION_VERSION) {
+            throw std::runtime_error("serialization: not a serialized HashMap of this version");
+        }
+        reader.read(&count, sizeof(count));
+        HashMap loaded(hasher_, key_equal_, get_allocator());
+        loaded.load_policy_ = load_policy_;
+        loaded.min_capacity_ = min_capacity_;
+        loaded.update_thresholds();
+        try {
+            // Capacity the table would have after growing to count, so that the next inserts don't rebuild it.
+            if (count > 0) {
+                const uint64_t element_size = SerializedMinSize<KeyType>::value + SerializedMinSize<ValueType>::value;
+                uint64_t available = reader.available();
+                uint64_t presize = available == std::numeric_limits<uint64_t>::max()
+                                   ? std::min<uint64_t>(count, HashMap::DESERIALIZE_PRESIZE_LIMIT)
+                                   : std::min<uint64_t>(count, available / element_size);
+                size_t capacity = loaded.rebuilt_capacity(static_cast<size_t>(presize));
+                if (capacity != loaded.current_capacity_) {
+                    loaded.rebuild(capacity);
+                }
+            }
+            for (uint64_t i = 0; i < count; ++i) {
+                loaded.load_element(reader, count);
+            }
+        } catch (const std::bad_alloc&) {
+            throw std::runtime_error("serialization: not enough memory for the table");
+        } catch (const std::length_error&) {
+            throw std::runtime_error("serialization: not enough memory for the table");
+        }
+        reader.finish();
+        loaded.set_incremental_rebuild(incremental_rebuild_);
+        loaded.set_parallel_rebuild(parallel_rebuild_);
+        loaded.set_thread_pool(thread_pool_);
+        swap(loaded);
+    }
+
     // Returns an iterator which points to first cell.
     iterator begin() {
         return iterator(this, 0, 0);
@@ -176,7 +754,7 @@ class HashMap {
 
     // Returns an iterator which points after last cell.
     iterator end() {
-        return iterator(this, table_.size(), 0);
+        return iterator(this, num_of_cells(), 0);
     }
 
     // Returns an iterator which points to first cell.
@@ -186,40 +764,42 @@ class HashMap {
 
     // Returns an iterator which points after last cell.
     const_iterator end() const {
-        return const_iterator(this, table_.size(), 0);
+        return const_iterator(this, num_of_cells(), 0);
     }
 
     /* Return a value by key.
        If key not found, creates new element in hashtable with default value. */
-    ValueType& operator[](KeyType key) {
-        size_t hash = hasher_(key) % current_capacity_;
-        for (const auto &pair : table_[hash]) {
-            if (pair->first == key) {
-                return pair->second;
-            }
-        }
-        insert(std::make_pair(key, ValueType()));
-        return (*this)[key];
+    ValueType& operator[](const KeyType& key) {
+        return try_emplace(key).first->second;
+    }
+
+    ValueType& operator[](KeyType&& key) {
+        return try_emplace(std::move(key)).first->second;
     }
 
     /* Return a value by key.
        If key not found, throws std::out_of_range. */
-    const ValueType& at(KeyType key) const {
-        size_t hash = hasher_(key) % current_capacity_;
-        for (const auto &pair : table_[hash]) {
-            if (pair->first == key) {
-                return pair->second;
-            }
-        }
-        throw std::out_of_range("ooops, your key is not found");
+    ValueType& at(const KeyType& key) {
+        return at_key(key);
+    }
+
+    const ValueType& at(const KeyType& key) const {
+        return at_key(key);
     }
 
     /* Iterator for the hash map
        Contains pointer to the HashMap object, and two parameters: cell and positon.
-       It means that iterator points to value stored in table_[cell][positon].
-       If iterator points to end of table_, it has cell = table_.size(). */
+       It means that iterator points to value stored in cell_at(cell)[positon].
+       Cells of the old table (during incremental rebuild) go first.
+       If iterator points to end of table_, it has cell = num_of_cells(). */
     class iterator {
       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const KeyType, ValueType>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = value_type*;
+        using reference = value_type&;
+
         iterator() {}
         
         iterator(HashMap *outer, size_t cell = 0, size_t positon = 0):
@@ -250,11 +830,11 @@ class HashMap {
         }
         
         std::pair<const KeyType, ValueType>& operator*() const {
-            return *outer->table_[cell][positon];
+            return *outer->cell_at(cell)[positon].node;
         }
         
         std::pair<const KeyType, ValueType>* operator->() const {
-            return &*(outer->table_[cell][positon]);
+            return outer->cell_at(cell)[positon].node;
         }
         
         bool operator==(const iterator& other) const {
@@ -268,14 +848,14 @@ class HashMap {
       private:
         // Moves iterator to next valid cell (or to end).
         void find_valid_cell() {
-            while (cell < outer->table_.size() && positon == outer->table_[cell].size()) {
+            while (cell < outer->num_of_cells() && positon == outer->cell_at(cell).size()) {
                 positon = 0;
                 cell++;
             }
         }
 
       private:
-        // Iterator points to outer->table_[cell][positon]
+        // Iterator points to outer->cell_at(cell)[positon]
         HashMap *outer = nullptr;
         size_t cell;
         size_t positon;
@@ -283,10 +863,17 @@ class HashMap {
 
     /* Const iterator for the hash map
        Contains pointer to the HashMap object, and two parameters: cell and positon.
-       It means that iterator points to value stored in table_[cell][positon].
-       If iterator points to end of table_, it has cell = table_.size(). */
+       It means that iterator points to value stored in cell_at(cell)[positon].
+       Cells of the old table (during incremental rebuild) go first.
+       If iterator points to end of table_, it has cell = num_of_cells(). */
     class const_iterator {
       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const KeyType, ValueType>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
         const_iterator() {}
         
         const_iterator(const HashMap *outer, size_t cell = 0, size_t positon = 0):
@@ -317,11 +904,11 @@ class HashMap {
         }
         
         const std::pair<const KeyType, ValueType>& operator*() const {
-            return *outer->table_[cell][positon];
+            return *outer->cell_at(cell)[positon].node;
         }
         
         const std::pair<const KeyType, ValueType>* operator->() const {
-            return &*(outer->table_[cell][positon]);
+            return outer->cell_at(cell)[positon].node;
         }
         
         bool operator==(const const_iterator& other) const {
@@ -335,57 +922,750 @@ class HashMap {
       private:
         // Moves iterator to next valid cell (or to end).
         void find_valid_cell() {
-            while (cell < outer->table_.size() && positon == outer->table_[cell].size()) {
+            while (cell < outer->num_of_cells() && positon == outer->cell_at(cell).size()) {
                 positon = 0;
                 cell++;
             }
         }
 
       private:
-        // Iterator points to outer->table_[cell][positon].
+        // Iterator points to outer->cell_at(cell)[positon].
         const HashMap *outer = nullptr;
         size_t cell;
         size_t positon;
     };
 
   private:
-    /* Stop the world: making capacity = size * 2, then replace elements to other table.
-       Complexity is O(size). */
-    void rebuild() {
-        current_capacity_ = std::max(HashMap::MIN_NUM_OF_CELLS, size() * 2);
-        std::vector<std::vector<pair_ptr>> for_change(current_capacity_);
+    // Returns position of the key in the cell, or size of the cell if key is not there.
+    template<class K>
+    size_t position_of(const K& key, size_t hash, size_t cell) const {
+        return position_of(key, hash, cell, this->counters());
+    }
+
+    // Same, but the work is counted by counters: a parallel pass gives every thread its own.
+    template<class K>
+    size_t position_of(const K& key, size_t hash, size_t cell, Instrumentation& counters) const {
+        const auto &entries = cell_at(cell);
+        for (size_t i = 0; i < entries.size(); i++) {
+            counters.probed(1);
+            if (entries[i].may_match(hash)) {
+                counters.compared(1);
+                if (key_equal_(key, entries[i].node->first)) {
+                    return i;
+                }
+            }
+        }
+        return entries.size();
+    }
+
+    // Hash of a key, every call of the hash function goes through here or entry_hash().
+    template<class K>
+    size_t hash_key(const K& key) const {
+        this->counters().hashed(1);
+        return hasher_(key);
+    }
+
+    // Hash of the key of an entry: the stored one, or the hash function is called.
+    size_t entry_hash(const entry& e) const {
+        this->counters().hashed(StoreHash<KeyType>::value ? 0 : 1);
+        return e.hash(hasher_);
+    }
+
+    // Constructs a node in the pool.
+    template<class... Args>
+    pair_ptr create_node(Args&&... args) {
+        pair_ptr node = pool_.create(std::forward<Args>(args)...);
+        this->counters().allocated(1);
+        return node;
+    }
+
+    /* Pipeline of find_many(): key i is hashed at step i, its entries are prefetched at step
+       i + FIND_MANY_WINDOW, its nodes at step i + 2 * FIND_MANY_WINDOW, and it is compared
+       at step i + 3 * FIND_MANY_WINDOW. visit(cell, position) is called in the order of keys. */
+    template<class Visit>
+    void find_many_positions(const KeyType* keys, size_t n, Visit&& visit) const {
+        constexpr size_t window = HashMap::FIND_MANY_WINDOW;
+        constexpr size_t ring = 4 * HashMap::FIND_MANY_WINDOW;
+        size_t hashes[ring];
+        size_t cells[ring];
+        for (size_t step = 0; step < n + 3 * window; ++step) {
+            if (step < n) {
+                size_t slot = step % ring;
+                hashes[slot] = hash_key(keys[step]);
+                cells[slot] = cell_of(hashes[slot]);
+                prefetch(&cell_at(cells[slot]));
+            }
+            if (step >= window && step - window < n) {
+                const auto &entries = cell_at(cells[(step - window) % ring]);
+                if (!entries.empty()) {
+                    prefetch(entries.data());
+                }
+            }
+            if (step >= 2 * window && step - 2 * window < n) {
+                size_t slot = (step - 2 * window) % ring;
+                for (const auto &p : cell_at(cells[slot])) {
+                    if (p.may_match(hashes[slot])) {
+                        prefetch(p.node);
+                    }
+                }
+            }
+            if (step >= 3 * window) {
+                size_t index = step - 3 * window;
+                size_t slot = index % ring;
+                visit(cells[slot], position_of(keys[index], hashes[slot], cells[slot]));
+            }
+        }
+    }
+
+    static void prefetch(const void* address) {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+    template<class K>
+    iterator find_key(const K& key) {
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(key, hash, cell);
+        if (position == cell_at(cell).size()) {
+            return end();
+        }
+        return iterator(this, cell, position);
+    }
+
+    template<class K>
+    const_iterator find_key(const K& key) const {
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(key, hash, cell);
+        if (position == cell_at(cell).size()) {
+            return end();
+        }
+        return const_iterator(this, cell, position);
+    }
+
+    template<class K>
+    ValueType& at_key(const K& key) {
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(key, hash, cell);
+        if (position == cell_at(cell).size()) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return cell_at(cell)[position].node->second;
+    }
+
+    template<class K>
+    const ValueType& at_key(const K& key) const {
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(key, hash, cell);
+        if (position == cell_at(cell).size()) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return cell_at(cell)[position].node->second;
+    }
+
+    template<class K>
+    void erase_key(const K& key) {
+        migrate_step();
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        auto &entries = cell_at(cell);
+        size_t position = position_of(key, hash, cell);
+        if (position == entries.size()) {
+            return;
+        }
+        /* erasing pair from cell */
+        pool_.destroy(entries[position].node);
+        entries.erase(entries.begin() + position);
+        current_size_--;
+        check_rebuild();
+    }
+
+    template<class Key, class... Args>
+    std::pair<iterator, bool> try_emplace_key(Key&& key, Args&&... args) {
+        migrate_step();
+        size_t hash = hash_key(key);
+        size_t cell = cell_of(hash);
+        size_t position = position_of(key, hash, cell);
+        if (position != cell_at(cell).size()) {
+            return std::make_pair(iterator(this, cell, position), false);
+        }
+        pair_ptr node = create_node(std::piecewise_construct,
+                                    std::forward_as_tuple(std::forward<Key>(key)),
+                                    std::forward_as_tuple(std::forward<Args>(args)...));
+        return std::make_pair(insert_node(node, hash), true);
+    }
+
+    /* Inserts the node with a new key, hash is the hash of its key.
+       The table grows before the insert, so the returned iterator stays valid. */
+    iterator insert_node(pair_ptr node, size_t hash) {
+        if (size() + 1 > grow_threshold_) {
+            try {
+                rebuild(grown_capacity());
+            } catch (...) {
+                pool_.destroy(node);
+                throw;
+            }
+        }
+        size_t cell = cell_of(hash);
+        push_node(cell_at(cell), node, hash);
+        current_size_++;
+        return iterator(this, cell, cell_at(cell).size() - 1);
+    }
+
+    template<class InputIterator>
+    void insert_range(InputIterator begin, InputIterator end, std::input_iterator_tag) {
+        for (; begin != end; ++begin) {
+            insert(*begin);
+        }
+    }
+
+    template<class ForwardIterator>
+    void insert_range(ForwardIterator begin, ForwardIterator end, std::forward_iterator_tag) {
+        size_t count = static_cast<size_t>(std::distance(begin, end));
+        presize(size() + count);
+        ThreadPool* threads = count < HashMap::PARALLEL_BUILD_SIZE ? nullptr : parallel_pool();
+        if (threads == nullptr) {
+            insert_range(begin, end, std::input_iterator_tag());
+            return;
+        }
+        using category = typename std::iterator_traits<ForwardIterator>::iterator_category;
+        if (std::is_base_of<std::random_access_iterator_tag, category>::value) {
+            parallel_insert(count, *threads, [&begin](size_t i) -> decltype(*begin) {
+                return *std::next(begin, i);
+            });
+            return;
+        }
+        std::vector<ForwardIterator> positions;
+        positions.reserve(count);
+        for (; begin != end; ++begin) {
+            positions.push_back(begin);
+        }
+        parallel_insert(count, *threads, [&positions](size_t i) -> decltype(*begin) {
+            return *positions[i];
+        });
+    }
+
+    size_t num_of_scan_chunks() const {
+        return (num_of_cells() + HashMap::PARALLEL_SCAN_CHUNK - 1) / HashMap::PARALLEL_SCAN_CHUNK;
+    }
+
+    /* Calls task(chunk, first, last) for every chunk of cells [first; last) on thread_pool().
+       Cells of an incremental rebuild's old table are included (see cell_at()). */
+    template<class Task>
+    void scan_chunks(const Task& task) const {
+        size_t cells = num_of_cells();
+        thread_pool().run(num_of_scan_chunks(), [&task, cells](size_t chunk) {
+            size_t first = chunk * HashMap::PARALLEL_SCAN_CHUNK;
+            task(chunk, first, std::min(cells, first + HashMap::PARALLEL_SCAN_CHUNK));
+        });
+    }
+
+    /* Pool for a parallel pass, nullptr if the pass must run in this thread.
+       Cells and nodes may be allocated from several threads at once only if the allocator
+       is stateless, a memory resource of a pmr allocator is not thread safe in general.
+       The first call may start the threads of ThreadPool::instance(), so call it only for a pass
+       which is big enough. */
+    ThreadPool* parallel_pool() const {
+        if (!std::allocator_traits<Allocator>::is_always_equal::value) {
+            return nullptr;
+        }
+        ThreadPool& threads = thread_pool();
+        return threads.num_of_threads() > 1 ? &threads : nullptr;
+    }
+
+    /* Inserts count elements element(0), ..., element(count - 1) in three parallel passes:
+       1. Every thread hashes a chunk of the elements and counts them by parts (ranges of cells).
+       2. Every thread writes the numbers of its elements to their parts, in order.
+       3. Every part is filled by one thread from its own run of nodes, in order of elements,
+          so the first of equal keys wins as with sequential inserts. */
+    template<class Element>
+    void parallel_insert(size_t count, ThreadPool& threads, Element element) {
+        finish_migration();
+        const size_t num_of_parts = 4 * threads.num_of_threads();
+        const size_t num_of_cells = table_.size();
+        auto part_of = [num_of_parts, num_of_cells](size_t cell) {
+            return cell * num_of_parts / num_of_cells;
+        };
+        auto chunk_begin = [count, num_of_parts](size_t chunk) {
+            return count / num_of_parts * chunk + std::min(chunk, count % num_of_parts);
+        };
+
+        std::vector<size_t> hashes(count);
+        std::vector<size_t> offsets(num_of_parts * num_of_parts, 0);
+        threads.run(num_of_parts, [&](size_t chunk) {
+            size_t* chunk_offsets = &offsets[chunk * num_of_parts];
+            for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+                hashes[i] = hasher_(element(i).first);
+                chunk_offsets[part_of(capacity_policy_.index(hashes[i]))]++;
+            }
+        });
+        // offsets[chunk][part] becomes the position of the first element of the chunk in the part.
+        std::vector<size_t> part_begin(num_of_parts + 1, 0);
+        size_t position = 0;
+        for (size_t part = 0; part < num_of_parts; ++part) {
+            part_begin[part] = position;
+            for (size_t chunk = 0; chunk < num_of_parts; ++chunk) {
+                size_t chunk_count = offsets[chunk * num_of_parts + part];
+                offsets[chunk * num_of_parts + part] = position;
+                position += chunk_count;
+            }
+        }
+        part_begin[num_of_parts] = position;
+
+        std::vector<size_t> order(count);
+        threads.run(num_of_parts, [&](size_t chunk) {
+            size_t* chunk_offsets = &offsets[chunk * num_of_parts];
+            for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+                order[chunk_offsets[part_of(capacity_policy_.index(hashes[i]))]++] = i;
+            }
+        });
+
+        std::vector<typename NodePool<value_type, Allocator>::Run> runs;
+        runs.reserve(num_of_parts);
+        for (size_t part = 0; part < num_of_parts; ++part) {
+            runs.push_back(pool_.allocate_run(part_begin[part + 1] - part_begin[part]));
+        }
+        this->counters().hashed(count);
+        std::vector<size_t> used(num_of_parts, 0);
+        std::vector<Instrumentation> part_counters(num_of_parts);
+        try {
+            threads.run(num_of_parts, [&](size_t part) {
+                for (size_t j = part_begin[part]; j < part_begin[part + 1]; ++j) {
+                    size_t i = order[j];
+                    size_t cell = capacity_policy_.index(hashes[i]);
+                    if (position_of(element(i).first, hashes[i], cell, part_counters[part]) != table_[cell].size()) {
+                        continue;
+                    }
+                    pair_ptr node = pool_.create_in(runs[part], used[part], element(i));
+                    used[part]++;
+                    try {
+                        table_[cell].push_back(entry(node, hashes[i]));
+                    } catch (...) {
+                        used[part]--;
+                        Allocator allocator(get_allocator());
+                        std::allocator_traits<Allocator>::destroy(allocator, node);
+                        throw;
+                    }
+                }
+            });
+        } catch (...) {
+            finish_parallel_insert(runs, used, part_counters);
+            throw;
+        }
+        finish_parallel_insert(runs, used, part_counters);
+        check_rebuild();
+    }
+
+    /* Counts the nodes made by parallel_insert() and gives the rest of the runs back to the pool,
+       adds the work of the parts to counters(). */
+    template<class Runs>
+    void finish_parallel_insert(const Runs& runs, const std::vector<size_t>& used,
+                                const std::vector<Instrumentation>& part_counters) {
+        for (size_t part = 0; part < runs.size(); ++part) {
+            current_size_ += used[part];
+            pool_.release_run(runs[part], used[part]);
+            this->counters().allocated(used[part]);
+            this->counters().merge(part_counters[part]);
+        }
+    }
+
+    /* Reads one element of deserialize() and puts it into its cell, the table is not
+       in incremental rebuild. Repeated keys mean the stream is corrupted.
+       A table presized for less than count grows for eight times the elements read so far. */
+    void load_element(StreamReader& reader, uint64_t count) {
+        if (size() + 1 > grow_threshold_) {
+            size_t expected = static_cast<size_t>(std::min<uint64_t>(count, 8 * uint64_t(size())));
+            rebuild(std::max(grown_capacity(), rebuilt_capacity(expected)));
+        }
+        KeyType key = Serializer<KeyType>::read(reader);
+        ValueType value = Serializer<ValueType>::read(reader);
+        pair_ptr node = create_node(std::move(key), std::move(value));
+        size_t hash = hash_key(node->first);
+        size_t cell = capacity_policy_.index(hash);
+        if (position_of(node->first, hash, cell) != table_[cell].size()) {
+            pool_.destroy(node);
+            throw std::runtime_error("serialization: repeated key in the stream");
+        }
+        push_node(table_[cell], node, hash);
+        current_size_++;
+    }
+
+    // Copies settings which are not a part of the contents, and presizes for other's elements.
+    void copy_settings(const HashMap& other) {
+        load_policy_ = other.load_policy_;
+        incremental_rebuild_ = other.incremental_rebuild_;
+        parallel_rebuild_ = other.parallel_rebuild_;
+        thread_pool_ = other.thread_pool_;
+        update_thresholds();
+        presize(other.size());
+    }
+
+    // Puts a new node to the cell, the node goes back to the pool if the cell can't grow.
+    void push_node(cell_type& cell, pair_ptr node, size_t hash) {
+        try {
+            cell.push_back(entry(node, hash));
+        } catch (...) {
+            pool_.destroy(node);
+            throw;
+        }
+    }
+
+    /* Destroys all elements, cells are left with dangling pointers.
+       Trivially destructible elements are left as is, their memory is freed with the pool chunks. */
+    void destroy_nodes() {
+        if (std::is_trivially_destructible<value_type>::value) {
+            return;
+        }
+        for (auto& cell : old_table_) {
+            for (auto &p : cell) {
+                pool_.destroy(p.node);
+            }
+        }
+        for (auto& cell : table_) {
+            for (auto &p : cell) {
+                pool_.destroy(p.node);
+            }
+        }
+    }
+
+    /* Number of the cell for the hash. Cells of old_table_ go first, then cells of table_.
+       During incremental rebuild a key lives in the old table until its old cell is moved
+       (old cells are moved from the back), so there is still exactly one cell to look at. */
+    size_t cell_of(size_t hash) const {
+        if (!old_table_.empty()) {
+            size_t old_cell = old_capacity_policy_.index(hash);
+            if (old_cell < old_table_.size()) {
+                return old_cell;
+            }
+        }
+        return old_table_.size() + capacity_policy_.index(hash);
+    }
+
+    cell_type& cell_at(size_t cell) {
+        return cell < old_table_.size() ? old_table_[cell] : table_[cell - old_table_.size()];
+    }
+
+    const cell_type& cell_at(size_t cell) const {
+        return cell < old_table_.size() ? old_table_[cell] : table_[cell - old_table_.size()];
+    }
+
+    size_t num_of_cells() const {
+        return old_table_.size() + table_.size();
+    }
+
+    // Sets up an empty table of minimal capacity.
+    void init_table() {
+        current_capacity_ = CapacityPolicy::round_up(std::max(HashMap::MIN_NUM_OF_CELLS, min_capacity_));
+        table_.resize(current_capacity_);
+        capacity_policy_.reset(current_capacity_);
+        update_thresholds();
+    }
+
+    // Recomputes size bounds of the current capacity from the load factor settings.
+    void update_thresholds() {
+        grow_threshold_ = static_cast<size_t>(std::floor(current_capacity_ * double(load_policy_.max_load_factor)));
+        shrink_threshold_ = 0;
+        if (load_policy_.shrink) {
+            shrink_threshold_ = static_cast<size_t>(std::ceil(current_capacity_ * double(load_policy_.min_load_factor)));
+        }
+    }
+
+    /* Capacity where size elements have load factor max_load_factor / growth_factor.
+       Not less than the bound set by rehash(). */
+    size_t rebuilt_capacity(size_t size) const {
+        double capacity = std::ceil(size * double(load_policy_.growth_factor) / load_policy_.max_load_factor);
+        return CapacityPolicy::round_up(
+            std::max({HashMap::MIN_NUM_OF_CELLS, min_capacity_, static_cast<size_t>(capacity)}));
+    }
+
+    // Grows the table once, so that count elements fit without rebuilds. Does not set a bound.
+    void presize(size_t count) {
+        if (count > grow_threshold_) {
+            double capacity = std::ceil(count / double(load_policy_.max_load_factor));
+            rebuild(CapacityPolicy::round_up(static_cast<size_t>(capacity)));
+        }
+    }
+
+    /* Capacity after the next growth: current capacity times growth_factor.
+       It is computed from capacity, not from size, so that rounding up by the policy
+       does not make the load factor after growth lower than max_load_factor / growth_factor. */
+    size_t grown_capacity() const {
+        double capacity = std::ceil(current_capacity_ * double(load_policy_.growth_factor));
+        size_t result = CapacityPolicy::round_up(std::max(current_capacity_ + 1, static_cast<size_t>(capacity)));
+        if (size() > result * double(load_policy_.max_load_factor)) {
+            result = std::max(result, rebuilt_capacity(size()));
+        }
+        return result;
+    }
+
+    // Changes capacity to new_capacity by rebuild_table(), counts and times the change for stats().
+    void rebuild(size_t new_capacity) {
+        auto start = std::chrono::steady_clock::now();
+        bool grows = new_capacity > current_capacity_;
+        rebuild_table(new_capacity);
+        rebuild_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        (grows ? num_of_grows_ : num_of_shrinks_)++;
+    }
+
+    /* Stop the world: making capacity = new_capacity, then replace elements to other table.
+       Stored hashes are reused, otherwise every key is hashed again.
+       Complexity is O(size), divided between threads by parallel_rebuild_into().
+       In incremental mode elements are moved later by migrate_step(), and a growing table
+       takes the cells prepared in spare_table_. A shrinking table allocates its cells here. */
+    void rebuild_table(size_t new_capacity) {
+        finish_migration();
+        current_capacity_ = new_capacity;
+        update_thresholds();
+        if (incremental_rebuild_) {
+            table_type new_table(table_.get_allocator());
+            if (spare_table_.size() <= current_capacity_ && spare_table_.capacity() >= current_capacity_) {
+                new_table.swap(spare_table_);
+            }
+            new_table.resize(current_capacity_);
+            old_table_.swap(table_);
+            table_.swap(new_table);
+            old_capacity_policy_ = capacity_policy_;
+            capacity_policy_.reset(current_capacity_);
+            update_migration_step();
+            return;
+        }
+        CapacityPolicy new_capacity_policy;
+        new_capacity_policy.reset(current_capacity_);
+        table_type for_change(table_.get_allocator());
+        for_change.resize(current_capacity_);
+        ThreadPool* threads = parallel_rebuild_ && size() >= HashMap::PARALLEL_REBUILD_SIZE ? parallel_pool() : nullptr;
+        if (threads != nullptr) {
+            parallel_rebuild_into(for_change, new_capacity_policy, *threads);
+            this->counters().hashed(StoreHash<KeyType>::value ? 0 : size());
+            table_.swap(for_change);
+            capacity_policy_ = new_capacity_policy;
+            return;
+        }
         for (size_t i = 0; i < table_.size(); ++i) {
             for (auto &ptr : table_[i]) {
-                size_t hash = hasher_(ptr->first) % current_capacity_;
-                for_change[hash].push_back(std::move(ptr));
+                size_t cell = new_capacity_policy.index(entry_hash(ptr));
+                for_change[cell].push_back(ptr);
             }
         }
         table_.swap(for_change);
+        capacity_policy_ = new_capacity_policy;
     }
 
-    /* Checks that size belongs to [capacity / 4; capacity].
-       If not, rebuilds the table. */
-    void check_rebuild() {
-        if (size() * SCALE < current_capacity_) {
-            rebuild();
+    /* Moves entries of table_ to new_table in two parallel passes:
+       1. Every thread takes a range of old cells and stages their entries, with new cells,
+          in one list per range of new cells (part).
+       2. Every thread takes a part and moves its staged entries to the cells, list after list,
+          so entries of a cell keep the order of the serial rebuild.
+       table_ is not changed, so an exception leaves the table as it was. */
+    void parallel_rebuild_into(table_type& new_table, const CapacityPolicy& new_capacity_policy,
+                               ThreadPool& threads) {
+        struct Staged {
+            entry moved;
+            size_t cell;
+        };
+        const size_t num_of_parts = 4 * threads.num_of_threads();
+        const size_t num_of_old_cells = table_.size();
+        const size_t num_of_new_cells = new_table.size();
+        std::vector<std::vector<Staged>> staged(num_of_parts * num_of_parts);
+        threads.run(num_of_parts, [&](size_t chunk) {
+            std::vector<Staged>* chunk_staged = &staged[chunk * num_of_parts];
+            size_t last = num_of_old_cells * (chunk + 1) / num_of_parts;
+            for (size_t i = num_of_old_cells * chunk / num_of_parts; i < last; ++i) {
+                for (auto& ptr : table_[i]) {
+                    size_t cell = new_capacity_policy.index(ptr.hash(hasher_));
+                    chunk_staged[cell * num_of_parts / num_of_new_cells].push_back(Staged{ptr, cell});
+                }
+            }
+        });
+        threads.run(num_of_parts, [&](size_t part) {
+            for (size_t chunk = 0; chunk < num_of_parts; ++chunk) {
+                for (auto& entry : staged[chunk * num_of_parts + part]) {
+                    new_table[entry.cell].push_back(entry.moved);
+                }
+            }
+        });
+    }
+
+    /* Chooses how many cells every insert and erase moves or constructs after an incremental rebuild.
+       MIGRATION_STEP is enough for the default policy, but a small growth factor (or a narrow gap
+       between the load factors) brings the next rebuild closer: the old cells must be moved before
+       the size reaches either threshold, and the spare cells for the next growth must be ready
+       before it grows, otherwise that rebuild would finish all the work at once. */
+    void update_migration_step() {
+        size_t to_grow = grow_threshold_ > size() ? grow_threshold_ - size() : 0;
+        size_t to_shrink = size() > shrink_threshold_ ? size() - shrink_threshold_ : 0;
+        if (!load_policy_.shrink) {
+            to_shrink = to_grow;
         }
-        if (size() > current_capacity_) {
-            rebuild();
+        size_t operations = std::max<size_t>(1, std::min(to_grow, to_shrink));
+        size_t work = old_table_.size() + grown_capacity();
+        migration_step_ = std::max({HashMap::MIGRATION_STEP,
+                                    (old_table_.size() + operations - 1) / operations,
+                                    (work + std::max<size_t>(1, to_grow) - 1) / std::max<size_t>(1, to_grow)});
+    }
+
+    /* Does a bounded amount of incremental rebuild work:
+       moves migration_step_ cells from the back of the old table if a migration is in progress,
+       otherwise constructs migration_step_ cells of the table for the next growth once the table
+       is half way to the growth, or destroys them if it is not. */
+    void migrate_step() {
+        if (!old_table_.empty()) {
+            for (size_t step = 0; step < migration_step_ && !old_table_.empty(); ++step) {
+                migrate_cell(old_table_.back());
+                old_table_.pop_back();
+            }
+            if (old_table_.empty()) {
+                table_type(old_table_.get_allocator()).swap(old_table_);
+            }
+            return;
+        }
+        if (!incremental_rebuild_) {
+            return;
+        }
+        size_t next_capacity = grown_capacity();
+        bool growing = size() * 2 > grow_threshold_;
+        if (growing && spare_table_.empty() && spare_table_.capacity() < next_capacity) {
+            spare_table_.reserve(next_capacity);
+        }
+        for (size_t step = 0; step < migration_step_; ++step) {
+            if (growing && spare_table_.size() < std::min(next_capacity, spare_table_.capacity())) {
+                spare_table_.emplace_back();
+            } else if (!growing && !spare_table_.empty()) {
+                spare_table_.pop_back();
+            } else {
+                break;
+            }
+        }
+    }
+
+    // Moves all remaining cells of the old table.
+    void finish_migration() {
+        while (!old_table_.empty()) {
+            migrate_step();
+        }
+    }
+
+    // Moves entries of one old cell to the new table, all or nothing.
+    void migrate_cell(cell_type& old_cell) {
+        size_t moved = 0;
+        try {
+            for (; moved < old_cell.size(); ++moved) {
+                table_[capacity_policy_.index(entry_hash(old_cell[moved]))].push_back(old_cell[moved]);
+            }
+        } catch (...) {
+            while (moved > 0) {
+                moved--;
+                table_[capacity_policy_.index(entry_hash(old_cell[moved]))].pop_back();
+            }
+            throw;
+        }
+        cell_type(old_cell.get_allocator()).swap(old_cell);
+    }
+
+    /* Checks that size belongs to [capacity * min_load_factor; capacity * max_load_factor].
+       If not, rebuilds the table. Shrink is skipped if it would not make the table smaller
+       (table of minimal capacity). */
+    void check_rebuild() {
+        if (size() > grow_threshold_) {
+            rebuild(grown_capacity());
+        } else if (size() < shrink_threshold_) {
+            size_t new_capacity = rebuilt_capacity(size());
+            if (new_capacity < current_capacity_) {
+                rebuild(new_capacity);
+            }
         }
     }
 
   private:
     Hash hasher_;
-    std::vector<std::vector<pair_ptr>> table_;
+    KeyEqual key_equal_;
+    table_type table_;
+    NodePool<value_type, Allocator> pool_;
 
-    // Size must be in [capacity / 4; capacity].
+    // Size must be in [shrink_threshold_; grow_threshold_].
     // Capacity not less than MIN_NUM_OF_CELLS.
     size_t current_size_= 0;
     size_t current_capacity_ = 0;
+    CapacityPolicy capacity_policy_;
+    LoadFactorPolicy load_policy_ = LoadFactorPolicy::from<LoadFactorDefaults>();
+    size_t grow_threshold_ = 0;
+    size_t shrink_threshold_ = 0;
+    // Capacity never shrinks below this bound, it is set by rehash() and reserve().
+    size_t min_capacity_ = 0;
+
+    // Table which is being moved to table_ by an incremental rebuild, empty otherwise.
+    // Moved cells are popped from its back.
+    table_type old_table_;
+    CapacityPolicy old_capacity_policy_;
+    // Empty cells prepared for the next growth in incremental mode.
+    table_type spare_table_;
+    bool incremental_rebuild_ = false;
+    bool parallel_rebuild_ = false;
+    // Pool of the parallel passes, nullptr for ThreadPool::instance().
+    ThreadPool* thread_pool_ = nullptr;
+    // Cells moved or constructed by one insert or erase in incremental mode, see update_migration_step().
+    size_t migration_step_ = HashMap::MIGRATION_STEP;
+
+    // Rebuild history for stats().
+    size_t num_of_grows_ = 0;
+    size_t num_of_shrinks_ = 0;
+    double rebuild_seconds_ = 0;
 };
 
-template<class KeyType, class ValueType, class Hash>
-constexpr size_t HashMap<KeyType, ValueType, Hash>::MIN_NUM_OF_CELLS = 10;
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::MIN_NUM_OF_CELLS = 10;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::MIGRATION_STEP = 8;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::PARALLEL_BUILD_SIZE = 1 << 16;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::PARALLEL_REBUILD_SIZE = 1 << 18;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::PARALLEL_SCAN_CHUNK = 4096;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr uint64_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                           CapacityPolicy, LoadFactorDefaults, Instrumentation>::SERIALIZATION_MAGIC = 0x3150414d48534148ull;  // "HASHMAP1"
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr uint32_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                           CapacityPolicy, LoadFactorDefaults, Instrumentation>::SERIALIZATION_VERSION = 1;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+constexpr size_t HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator,
+                         CapacityPolicy, LoadFactorDefaults, Instrumentation>::DESERIALIZE_PRESIZE_LIMIT = 1 << 20;
 
-template<class KeyType, class ValueType, class Hash>
-constexpr size_t HashMap<KeyType, ValueType, Hash>::SCALE = 4;
\ No newline at end of file
+namespace pmr {
+    /* HashMap which takes nodes and cells from a std::pmr::memory_resource.
+       With std::pmr::monotonic_buffer_resource a map is thrown away without freeing every node. */
+    template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType>,
+             class KeyEqual = std::equal_to<KeyType>,
+             class CapacityPolicy = ModuloCapacity, class LoadFactorDefaults = DefaultLoadFactor,
+             class Instrumentation = NoOperationCounters>
+    using HashMap = ::HashMap<KeyType, ValueType, Hash, KeyEqual,
+                              std::pmr::polymorphic_allocator<std::pair<const KeyType, ValueType>>,
+                              CapacityPolicy, LoadFactorDefaults, Instrumentation>;
+}
\ No newline at end of file
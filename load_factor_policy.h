@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdexcept>
+
+/* Default load factor settings of HashMap.
+   To change them at compile time, pass a struct with the same members
+   as the LoadFactorDefaults template parameter of HashMap. */
+struct DefaultLoadFactor {
+    // Table grows when size > capacity * MAX_LOAD_FACTOR.
+    static constexpr float MAX_LOAD_FACTOR = 1.0f;
+    // Table shrinks when size < capacity * MIN_LOAD_FACTOR (if SHRINK is true).
+    static constexpr float MIN_LOAD_FACTOR = 0.25f;
+    // Growth multiplies capacity by GROWTH_FACTOR, so load factor after growth is
+    // MAX_LOAD_FACTOR / GROWTH_FACTOR. Shrink goes to the same load factor.
+    static constexpr float GROWTH_FACTOR = 2.0f;
+    static constexpr bool SHRINK = true;
+};
+
+// Same as DefaultLoadFactor, but the table never shrinks on erase.
+struct NoShrinkLoadFactor : DefaultLoadFactor {
+    static constexpr bool SHRINK = false;
+};
+
+/* Load factor settings of one HashMap, can be changed at runtime.
+   Settings must keep a hysteresis gap: after a rebuild the load factor is
+   max_load_factor / growth_factor, and it must change at least growth_factor times
+   in either direction before the next rebuild, that is
+   min_load_factor * growth_factor * growth_factor <= max_load_factor.
+   So a sequence of inserts and erases near one threshold can't rebuild the table every time. */
+struct LoadFactorPolicy {
+    float max_load_factor = DefaultLoadFactor::MAX_LOAD_FACTOR;
+    float min_load_factor = DefaultLoadFactor::MIN_LOAD_FACTOR;
+    float growth_factor = DefaultLoadFactor::GROWTH_FACTOR;
+    bool shrink = DefaultLoadFactor::SHRINK;
+
+    template<class Defaults>
+    static LoadFactorPolicy from() {
+        LoadFactorPolicy policy;
+        policy.max_load_factor = Defaults::MAX_LOAD_FACTOR;
+        policy.min_load_factor = Defaults::MIN_LOAD_FACTOR;
+        policy.growth_factor = Defaults::GROWTH_FACTOR;
+        policy.shrink = Defaults::SHRINK;
+        policy.validate();
+        return policy;
+    }
+
+    // Throws std::invalid_argument if settings are out of range or break the hysteresis gap.
+    void validate() const {
+        if (!(max_load_factor > 0)) {
+            throw std::invalid_argument("max_load_factor must be positive");
+        }
+        if (!(growth_factor > 1)) {
+            throw std::invalid_argument("growth_factor must be more than 1");
+        }
+        if (!(min_load_factor >= 0)) {
+            throw std::invalid_argument("min_load_factor must be non-negative");
+        }
+        if (shrink && min_load_factor * growth_factor * growth_factor > max_load_factor) {
+            throw std::invalid_argument("min_load_factor * growth_factor^2 must not exceed max_load_factor");
+        }
+    }
+};
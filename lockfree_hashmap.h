@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "epoch_reclaimer.h"
+
+/* Lock-free hashtable with open addressing and linear probing.
+   Every slot is one atomic word: pointer to an immutable node with the key and the value,
+   and two mark bits. A key keeps its slot until the table is replaced: erase marks the node
+   DEAD, a later insert of the same key replaces it, insert_or_assign replaces the node.
+   Lookups only read shared memory, they never wait and never help.
+   Resize is cooperative: a full table gets a next table (bigger, or of the same size if most
+   of its keys are dead), and writers copy it by chunks of MIGRATION_CHUNK slots. A copied slot
+   is marked FROZEN. Writers wait for the copy to finish (and help it) before they write
+   to the next table, so it gets nothing but copies until then, and a lookup which finds
+   a frozen slot takes its node unless the next table already has the key.
+   A writer never waits for one thread: if all chunks are handed out but some are not done,
+   it copies the whole table itself (copying a slot twice does nothing).
+   Replaced nodes and replaced tables are freed by EpochReclaimer.
+   Every operation is linearizable, find() returns a copy of the value.
+   KeyType and ValueType must be copy constructible (resize copies nodes). */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+         class KeyEqual = std::equal_to<KeyType>>
+class LockFreeHashMap {
+  public:
+    // Minimal number of slots (power of two). Also used for initialization.
+    static const size_t MIN_NUM_OF_CELLS;
+    // Number of old slots a writer takes at once while copying a table.
+    static const size_t MIGRATION_CHUNK;
+
+    using value_type = std::pair<const KeyType, ValueType>;
+
+    explicit LockFreeHashMap(const Hash& hash_function = Hash(), const KeyEqual& key_equal = KeyEqual()):
+                             hasher_(hash_function), key_equal_(key_equal) {
+        head_.store(new Table(LockFreeHashMap::MIN_NUM_OF_CELLS));
+    }
+
+    LockFreeHashMap(const LockFreeHashMap&) = delete;
+    LockFreeHashMap& operator=(const LockFreeHashMap&) = delete;
+
+    // No other thread may use the map during destruction.
+    ~LockFreeHashMap() {
+        Table* table = head_.load();
+        while (table != nullptr) {
+            Table* next = table->next.load();
+            delete table;
+            table = next;
+        }
+    }
+
+    // Returns a copy of the value by key, or nothing if key not found.
+    std::optional<ValueType> find(const KeyType& key) const {
+        EpochReclaimer::Guard guard;
+        const Node* node = find_node(key, hasher_(key));
+        if (node == nullptr) {
+            return std::nullopt;
+        }
+        return node->pair.second;
+    }
+
+    bool contains(const KeyType& key) const {
+        EpochReclaimer::Guard guard;
+        return find_node(key, hasher_(key)) != nullptr;
+    }
+
+    size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    // Inserts an element if its key is absent. Returns whether the element was inserted.
+    bool insert(const value_type& pair) {
+        return write(pair.first, Mode::INSERT, [&pair](size_t hash) {
+            return new Node(hash, pair);
+        });
+    }
+
+    // Constructs the value from args if key is absent. Returns whether the element was inserted.
+    template<class... Args>
+    bool try_emplace(const KeyType& key, Args&&... args) {
+        return write(key, Mode::INSERT, [&](size_t hash) {
+            return new Node(hash, std::piecewise_construct, std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+        });
+    }
+
+    // Inserts the value or replaces the value of the existing element. Returns whether the element was inserted.
+    template<class Value>
+    bool insert_or_assign(const KeyType& key, Value&& value) {
+        return write(key, Mode::ASSIGN, [&](size_t hash) {
+            return new Node(hash, key, std::forward<Value>(value));
+        });
+    }
+
+    // Erases the element by key. Returns whether it was present.
+    bool erase(const KeyType& key) {
+        return write(key, Mode::ERASE, [](size_t) -> Node* {
+            return nullptr;
+        });
+    }
+
+    // Number of elements, exact when no writes are in progress.
+    size_t size() const {
+        ptrdiff_t size = size_.load(std::memory_order_relaxed);
+        return size > 0 ? static_cast<size_t>(size) : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Number of slots in the newest table.
+    size_t capacity() const {
+        EpochReclaimer::Guard guard;
+        Table* table = head_.load(std::memory_order_acquire);
+        for (Table* next = table->next.load(std::memory_order_acquire); next != nullptr;
+             next = next->next.load(std::memory_order_acquire)) {
+            table = next;
+        }
+        return table->capacity;
+    }
+
+  private:
+    struct Node {
+        template<class... Args>
+        Node(size_t hash, Args&&... args): hash(hash), pair(std::forward<Args>(args)...) {}
+
+        size_t hash;
+        value_type pair;
+    };
+
+    // Marks in the low bits of a slot word. A word without a node and marks is an empty slot.
+    static constexpr uintptr_t FROZEN = 1;
+    static constexpr uintptr_t DEAD = 2;
+    static constexpr uintptr_t MARKS = FROZEN | DEAD;
+
+    struct Table {
+        explicit Table(size_t capacity): capacity(capacity), slots(new std::atomic<uintptr_t>[capacity]) {
+            shift = 64;
+            while ((size_t(1) << (64 - shift)) < capacity) {
+                shift--;
+            }
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Deletes the nodes which are still in the slots, replaced nodes were retired before.
+        ~Table() {
+            for (size_t i = 0; i < capacity; ++i) {
+                delete node_of(slots[i].load(std::memory_order_relaxed));
+            }
+        }
+
+        size_t capacity;
+        unsigned shift;
+        std::unique_ptr<std::atomic<uintptr_t>[]> slots;
+        std::atomic<Table*> next{nullptr};
+        // Slots which ever got a key, resize starts when they exceed 3/4 of capacity.
+        std::atomic<size_t> claimed{0};
+        // Resize progress: chunks handed out to writers and chunks finished.
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<size_t> copied_chunks{0};
+    };
+
+    enum class Mode { INSERT, ASSIGN, ERASE };
+
+    static Node* node_of(uintptr_t word) {
+        return reinterpret_cast<Node*>(word & ~MARKS);
+    }
+
+    static bool is_live(uintptr_t word) {
+        return node_of(word) != nullptr && !(word & DEAD);
+    }
+
+    static size_t home(const Table* table, size_t hash) {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> table->shift);
+    }
+
+    /* Slot of the key in the table: the slot with this key or the first empty slot of its probe
+       sequence. Returns capacity if the table is full and the key is not there. */
+    size_t probe(const Table* table, const KeyType& key, size_t hash, uintptr_t& word) const {
+        size_t mask = table->capacity - 1;
+        size_t index = home(table, hash);
+        for (size_t step = 0; step < table->capacity; ++step) {
+            word = table->slots[index].load(std::memory_order_acquire);
+            Node* node = node_of(word);
+            if (node == nullptr || (node->hash == hash && key_equal_(node->pair.first, key))) {
+                return index;
+            }
+            index = (index + 1) & mask;
+        }
+        word = FROZEN;
+        return table->capacity;
+    }
+
+    /* Live node of the key or nullptr. Walks from the oldest table while the key's slot is frozen:
+       the node of a frozen slot is current unless the key got a slot in the next table. */
+    const Node* find_node(const KeyType& key, size_t hash) const {
+        const Node* result = nullptr;
+        for (Table* table = head_.load(std::memory_order_acquire); table != nullptr;
+             table = table->next.load(std::memory_order_acquire)) {
+            uintptr_t word;
+            probe(table, key, hash, word);
+            if (word == 0) {
+                break;
+            }
+            result = is_live(word) ? node_of(word) : nullptr;
+            if (!(word & FROZEN)) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    /* Applies the write to the newest table of the key.
+       make_node(hash) creates the node for INSERT and ASSIGN, it is called at most once. */
+    template<class MakeNode>
+    bool write(const KeyType& key, Mode mode, MakeNode make_node) {
+        EpochReclaimer::Guard guard;
+        size_t hash = hasher_(key);
+        Node* fresh = nullptr;
+        Table* table = head_.load(std::memory_order_acquire);
+        while (true) {
+            uintptr_t word;
+            size_t index = probe(table, key, hash, word);
+            Table* next = table->next.load(std::memory_order_acquire);
+            if (index == table->capacity && next == nullptr) {
+                start_resize(table);
+                continue;
+            }
+            if (next != nullptr) {
+                finish_migration(table);
+                table = next;
+                continue;
+            }
+            if (word & FROZEN) {
+                // Resize started after the probe.
+                continue;
+            }
+            uintptr_t desired;
+            if (mode == Mode::ERASE) {
+                if (!is_live(word)) {
+                    return false;
+                }
+                desired = word | DEAD;
+            } else {
+                if (mode == Mode::INSERT && is_live(word)) {
+                    delete fresh;
+                    return false;
+                }
+                if (fresh == nullptr) {
+                    fresh = make_node(hash);
+                }
+                desired = reinterpret_cast<uintptr_t>(fresh);
+            }
+            if (!table->slots[index].compare_exchange_strong(word, desired, std::memory_order_acq_rel)) {
+                continue;
+            }
+            if (word == 0 && table->claimed.fetch_add(1) + 1 > table->capacity / 4 * 3) {
+                start_resize(table);
+            }
+            bool was_live = is_live(word);
+            if (mode != Mode::ERASE && node_of(word) != nullptr) {
+                EpochReclaimer::instance().retire(node_of(word));
+            }
+            if (mode == Mode::ERASE) {
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (!was_live) {
+                size_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return !was_live;
+        }
+    }
+
+    /* Makes the table get a next table. Only the oldest table is resized, so a newer one
+       first waits for the copy of the older tables to finish (and helps it).
+       The next table is twice bigger, or of the same size if at most a quarter of slots is live. */
+    void start_resize(Table* table) {
+        if (table->next.load(std::memory_order_acquire) != nullptr) {
+            return;
+        }
+        while (true) {
+            Table* head = head_.load(std::memory_order_acquire);
+            if (head == table) {
+                break;
+            }
+            finish_migration(head);
+        }
+        size_t capacity = size() > table->capacity / 4 ? 2 * table->capacity : table->capacity;
+        Table* next = new Table(capacity);
+        Table* expected = nullptr;
+        if (!table->next.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+            delete next;
+        }
+    }
+
+    // Copies one chunk of the table to its next table, if there are chunks left.
+    void copy_chunk(Table* table) {
+        size_t num_of_chunks = (table->capacity + MIGRATION_CHUNK - 1) / MIGRATION_CHUNK;
+        if (table->next_chunk.load(std::memory_order_relaxed) >= num_of_chunks) {
+            return;
+        }
+        size_t chunk = table->next_chunk.fetch_add(1);
+        if (chunk >= num_of_chunks) {
+            return;
+        }
+        size_t end = std::min(table->capacity, (chunk + 1) * MIGRATION_CHUNK);
+        for (size_t index = chunk * MIGRATION_CHUNK; index < end; ++index) {
+            copy_slot(table, index);
+        }
+        if (table->copied_chunks.fetch_add(1) + 1 == num_of_chunks) {
+            promote(table);
+        }
+    }
+
+    /* Copies the rest of the table. If some chunks are held by other writers, copies
+       all slots itself (copying a slot twice does nothing), so no writer waits for another. */
+    void finish_migration(Table* table) {
+        size_t num_of_chunks = (table->capacity + MIGRATION_CHUNK - 1) / MIGRATION_CHUNK;
+        while (table->next_chunk.load(std::memory_order_relaxed) < num_of_chunks) {
+            copy_chunk(table);
+        }
+        if (table->copied_chunks.load(std::memory_order_acquire) < num_of_chunks) {
+            for (size_t index = 0; index < table->capacity; ++index) {
+                copy_slot(table, index);
+            }
+            promote(table);
+        }
+    }
+
+    // The old table is copied: the next one becomes the oldest, the old one is freed after readers leave it.
+    void promote(Table* table) {
+        Table* expected = table;
+        if (head_.compare_exchange_strong(expected, table->next.load(std::memory_order_acquire),
+                                          std::memory_order_acq_rel)) {
+            EpochReclaimer::instance().retire(table);
+        }
+    }
+
+    // Freezes the slot and copies its live node to the next table.
+    void copy_slot(Table* table, size_t index) {
+        uintptr_t word = table->slots[index].load(std::memory_order_acquire);
+        while (!(word & FROZEN)) {
+            if (table->slots[index].compare_exchange_weak(word, word | FROZEN, std::memory_order_acq_rel)) {
+                word |= FROZEN;
+                break;
+            }
+        }
+        if (is_live(word)) {
+            copy_node(table->next.load(std::memory_order_acquire), node_of(word));
+        }
+    }
+
+    /* Puts a copy of the node to the table unless its key already has a slot there:
+       then the key was copied before (or written after the copy finished, by a stale copier).
+       The table always has room: it is not smaller than the old one and gets only its keys. */
+    void copy_node(Table* table, const Node* node) {
+        Node* copy = nullptr;
+        while (true) {
+            uintptr_t word;
+            size_t index = probe(table, node->pair.first, node->hash, word);
+            if (index == table->capacity || node_of(word) != nullptr || (word & FROZEN)) {
+                delete copy;
+                return;
+            }
+            if (copy == nullptr) {
+                copy = new Node(node->hash, node->pair);
+            }
+            if (table->slots[index].compare_exchange_strong(word, reinterpret_cast<uintptr_t>(copy),
+                                                            std::memory_order_acq_rel)) {
+                table->claimed.fetch_add(1);
+                return;
+            }
+        }
+    }
+
+  private:
+    Hash hasher_;
+    KeyEqual key_equal_;
+    // Oldest table. Tables which are being copied link to their next table.
+    std::atomic<Table*> head_{nullptr};
+    std::atomic<ptrdiff_t> size_{0};
+};
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual>
+constexpr size_t LockFreeHashMap<KeyType, ValueType, Hash, KeyEqual>::MIN_NUM_OF_CELLS = 16;
+
+template<class KeyType, class ValueType, class Hash, class KeyEqual>
+constexpr size_t LockFreeHashMap<KeyType, ValueType, Hash, KeyEqual>::MIGRATION_CHUNK = 256;
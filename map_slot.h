@@ -0,0 +1,49 @@
+#pragma once
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/* Raw storage for one element of an open-addressing table.
+   Elements are exposed as std::pair<const KeyType, ValueType>, but open addressing
+   has to move them between slots, and a const key can only be copied.
+   So the slot keeps a union of both pair types and moves through the mutable one. */
+template<class KeyType, class ValueType>
+union MapSlot {
+    using value_type = std::pair<const KeyType, ValueType>;
+    using mutable_value_type = std::pair<KeyType, ValueType>;
+
+    MapSlot() {}
+    ~MapSlot() {}
+
+    template<class... Args>
+    void construct(Args&&... args) {
+        new (&value) value_type(std::forward<Args>(args)...);
+    }
+
+    void destroy() {
+        value.~value_type();
+    }
+
+    // Moves the element from other into this (empty) slot and destroys the original.
+    void transfer_from(MapSlot& other) {
+        new (&mutable_value) mutable_value_type(std::move(other.mutable_value));
+        other.destroy();
+    }
+
+    // Whether relocate_from() copies elements: their move may throw and they can be copied.
+    static constexpr bool RELOCATE_COPIES = !std::is_nothrow_move_constructible<mutable_value_type>::value &&
+                                            std::is_copy_constructible<mutable_value_type>::value;
+
+    /* Puts the element of other into this (empty) slot as std::move_if_noexcept does. A moved original
+       is destroyed, a copied one is kept, so after a failed copy the caller still has every element. */
+    void relocate_from(MapSlot& other) {
+        new (&mutable_value) mutable_value_type(std::move_if_noexcept(other.mutable_value));
+        if (!RELOCATE_COPIES) {
+            other.destroy();
+        }
+    }
+
+    value_type value;
+    mutable_value_type mutable_value;
+};
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capacity_policy.h"
+#include "hash_functions.h"
+#include "hashtable.h"
+
+/* Snapshot file of a hash table, written by save_snapshot() and read by MappedHashMap.
+   Layout, all offsets are from the start of the file, so the file may be mapped at any address:
+      1. SnapshotHeader.
+      2. num_of_cells + 1 offsets (uint64_t): records of cell i are [offsets[i]; offsets[i + 1]).
+      3. size records SnapshotRecord<KeyType, ValueType>, aligned to the record, cell after cell.
+   Cells are the cells of CapacityPolicy with num_of_cells capacity. The file is in the byte order
+   and layout of the machine which wrote it, the header lets a reader check that they match. */
+struct SnapshotHeader {
+    static const uint64_t MAGIC;
+    static const uint32_t VERSION;
+
+    uint64_t magic;
+    uint32_t version;
+    // Written as 1, reads differently on a machine with another byte order.
+    uint32_t byte_order;
+    uint64_t record_size;
+    uint64_t record_align;
+    uint64_t num_of_cells;
+    uint64_t size;
+    uint64_t offsets_offset;
+    uint64_t records_offset;
+};
+
+inline constexpr uint64_t SnapshotHeader::MAGIC = 0x31504e5348534148ull;  // "HASHSNP1"
+inline constexpr uint32_t SnapshotHeader::VERSION = 1;
+
+/* Element of a snapshot: the pair with the full hash of the key in front of it.
+   Fields are named like std::pair, so records read like elements of HashMap. */
+template<class KeyType, class ValueType>
+struct SnapshotRecord {
+    uint64_t hash;
+    KeyType first;
+    ValueType second;
+};
+
+/* Writes a snapshot file in one pass: first sizes of all cells, then records cell after cell.
+   Throws std::runtime_error if the file can't be written or the records don't match the sizes. */
+template<class KeyType, class ValueType>
+class SnapshotWriter {
+  public:
+    using record_type = SnapshotRecord<KeyType, ValueType>;
+
+    // Number of records collected before they are written to the file at once.
+    static const size_t BUFFER_SIZE;
+
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "snapshot keys and values are stored as bytes, they must be trivially copyable");
+
+    SnapshotWriter(const std::string& path, const std::vector<uint64_t>& cell_sizes):
+            path_(path), file_(path, std::ios::binary | std::ios::trunc) {
+        check("can't open");
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = SnapshotHeader::MAGIC;
+        header.version = SnapshotHeader::VERSION;
+        header.byte_order = 1;
+        header.record_size = sizeof(record_type);
+        header.record_align = alignof(record_type);
+        header.num_of_cells = cell_sizes.size();
+        header.offsets_offset = aligned(sizeof(SnapshotHeader), alignof(uint64_t));
+        header.records_offset = aligned(header.offsets_offset + (cell_sizes.size() + 1) * sizeof(uint64_t),
+                                        alignof(record_type));
+        std::vector<uint64_t> offsets(cell_sizes.size() + 1, 0);
+        for (size_t cell = 0; cell < cell_sizes.size(); ++cell) {
+            offsets[cell + 1] = offsets[cell] + cell_sizes[cell];
+        }
+        header.size = offsets.back();
+        expected_size_ = header.size;
+        write(&header, sizeof(header));
+        pad(header.offsets_offset);
+        write(offsets.data(), offsets.size() * sizeof(uint64_t));
+        pad(header.records_offset);
+        buffer_.reserve(SnapshotWriter::BUFFER_SIZE);
+    }
+
+    void add(uint64_t hash, const KeyType& key, const ValueType& value) {
+        if (written_ == expected_size_) {
+            throw std::runtime_error("snapshot " + path_ + ": more records than cells hold");
+        }
+        record_type record;
+        std::memset(&record, 0, sizeof(record));
+        record.hash = hash;
+        std::memcpy(&record.first, &key, sizeof(KeyType));
+        std::memcpy(&record.second, &value, sizeof(ValueType));
+        buffer_.push_back(record);
+        written_++;
+        if (buffer_.size() == SnapshotWriter::BUFFER_SIZE) {
+            flush_buffer();
+        }
+    }
+
+    // Flushes the file, all records must be added.
+    void finish() {
+        if (written_ != expected_size_) {
+            throw std::runtime_error("snapshot " + path_ + ": fewer records than cells hold");
+        }
+        flush_buffer();
+        file_.flush();
+        check("can't write");
+    }
+
+  private:
+    static uint64_t aligned(uint64_t offset, uint64_t align) {
+        return (offset + align - 1) / align * align;
+    }
+
+    void write(const void* data, size_t size) {
+        file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        position_ += size;
+        check("can't write");
+    }
+
+    void flush_buffer() {
+        write(buffer_.data(), buffer_.size() * sizeof(record_type));
+        buffer_.clear();
+    }
+
+    void pad(uint64_t offset) {
+        static const char zeros[64] = {};
+        while (position_ < offset) {
+            write(zeros, std::min<uint64_t>(sizeof(zeros), offset - position_));
+        }
+    }
+
+    void check(const char* what) {
+        if (!file_) {
+            throw std::runtime_error("snapshot " + path_ + ": " + what);
+        }
+    }
+
+  private:
+    std::string path_;
+    std::ofstream file_;
+    uint64_t position_ = 0;
+    uint64_t expected_size_ = 0;
+    uint64_t written_ = 0;
+    std::vector<record_type> buffer_;
+};
+
+template<class KeyType, class ValueType>
+constexpr size_t SnapshotWriter<KeyType, ValueType>::BUFFER_SIZE = 4096;
+
+/* Writes the table to a snapshot file which MappedHashMap reads without rebuilding.
+   Keys and values must be trivially copyable. Cells of the file are the current cells of the table,
+   so a snapshot is written without sorting, except during an incremental rebuild.
+   Throws std::runtime_error on I/O errors. */
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class CapacityPolicy, class LoadFactorDefaults, class Instrumentation>
+void save_snapshot(const HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, CapacityPolicy,
+                                 LoadFactorDefaults, Instrumentation>& map,
+                   const std::string& path) {
+    Hash hasher = map.hash_function();
+    std::vector<uint64_t> cell_sizes(map.bucket_count(), 0);
+    size_t in_cells = 0;
+    for (size_t cell = 0; cell < cell_sizes.size(); ++cell) {
+        cell_sizes[cell] = map.bucket_size(cell);
+        in_cells += cell_sizes[cell];
+    }
+    if (in_cells == map.size()) {
+        SnapshotWriter<KeyType, ValueType> writer(path, cell_sizes);
+        for (const auto& element : map) {
+            writer.add(hasher(element.first), element.first, element.second);
+        }
+        writer.finish();
+        return;
+    }
+    // Part of the elements is still in the old table of an incremental rebuild: sort them by cells.
+    std::fill(cell_sizes.begin(), cell_sizes.end(), 0);
+    for (const auto& element : map) {
+        cell_sizes[map.bucket(element.first)]++;
+    }
+    std::vector<size_t> next(cell_sizes.size() + 1, 0);
+    for (size_t cell = 0; cell < cell_sizes.size(); ++cell) {
+        next[cell + 1] = next[cell] + cell_sizes[cell];
+    }
+    std::vector<const std::pair<const KeyType, ValueType>*> sorted(map.size());
+    for (const auto& element : map) {
+        sorted[next[map.bucket(element.first)]++] = &element;
+    }
+    SnapshotWriter<KeyType, ValueType> writer(path, cell_sizes);
+    for (const auto* element : sorted) {
+        writer.add(hasher(element->first), element->first, element->second);
+    }
+    writer.finish();
+}
+
+/* Read-only hash table over a snapshot file mapped into memory.
+   Nothing is built on open, only the header and the offsets of the cells are checked:
+   find() and at() look the key up in the mapping, so the pages of the records are loaded
+   on first use by page faults.
+   Hash, KeyEqual and CapacityPolicy must be the ones of the HashMap which wrote the file,
+   and Hash must give the same values in both processes (DefaultHash does on machines of one
+   byte order, SeededHash does not). The first record is checked against them on open. */
+template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType>,
+         class KeyEqual = std::equal_to<KeyType>, class CapacityPolicy = ModuloCapacity>
+class MappedHashMap {
+  public:
+    using record_type = SnapshotRecord<KeyType, ValueType>;
+
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "snapshot keys and values are stored as bytes, they must be trivially copyable");
+
+    // Maps the file. Throws std::runtime_error if it can't be mapped or is not a valid snapshot.
+    explicit MappedHashMap(const std::string& path, const Hash& hash_function = Hash(),
+                           const KeyEqual& key_equal = KeyEqual()):
+            hasher_(hash_function), key_equal_(key_equal) {
+        map_file(path);
+        try {
+            read_header(path);
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    MappedHashMap(const MappedHashMap&) = delete;
+    MappedHashMap& operator=(const MappedHashMap&) = delete;
+
+    MappedHashMap(MappedHashMap&& other) noexcept:
+            hasher_(other.hasher_), key_equal_(other.key_equal_) {
+        swap(other);
+    }
+
+    MappedHashMap& operator=(MappedHashMap&& other) noexcept {
+        MappedHashMap moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    ~MappedHashMap() {
+        unmap();
+    }
+
+    void swap(MappedHashMap& other) noexcept {
+        std::swap(hasher_, other.hasher_);
+        std::swap(key_equal_, other.key_equal_);
+        std::swap(data_, other.data_);
+        std::swap(file_size_, other.file_size_);
+        std::swap(offsets_, other.offsets_);
+        std::swap(records_, other.records_);
+        std::swap(num_of_cells_, other.num_of_cells_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_policy_, other.capacity_policy_);
+    }
+
+    // Record of the key, nullptr if key is absent.
+    const record_type* find(const KeyType& key) const {
+        if (num_of_cells_ == 0) {
+            return nullptr;
+        }
+        uint64_t hash = hasher_(key);
+        size_t cell = capacity_policy_.index(hash);
+        for (uint64_t i = offsets_[cell]; i < offsets_[cell + 1]; ++i) {
+            if (records_[i].hash == hash && key_equal_(key, records_[i].first)) {
+                return &records_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // If key not found, throws std::out_of_range.
+    const ValueType& at(const KeyType& key) const {
+        const record_type* record = find(key);
+        if (record == nullptr) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return record->second;
+    }
+
+    size_t count(const KeyType& key) const {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    bool contains(const KeyType& key) const {
+        return find(key) != nullptr;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    size_t bucket_count() const {
+        return num_of_cells_;
+    }
+
+    // Records in file order, cell after cell.
+    const record_type* begin() const {
+        return records_;
+    }
+
+    const record_type* end() const {
+        return records_ + size_;
+    }
+
+    Hash hash_function() const {
+        return hasher_;
+    }
+
+    KeyEqual key_eq() const {
+        return key_equal_;
+    }
+
+  private:
+    void map_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("snapshot " + path + ": can't open");
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error("snapshot " + path + ": too short");
+        }
+        file_size_ = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("snapshot " + path + ": can't map");
+        }
+        data_ = data;
+    }
+
+    void unmap() {
+        if (data_ != nullptr) {
+            ::munmap(data_, file_size_);
+            data_ = nullptr;
+        }
+    }
+
+    /* Checks that the file is a snapshot of this table type and fits into the file,
+       and that the offsets of the cells never go back or past the records, since find() trusts them.
+       Costs one pass over the offsets, O(num_of_cells). */
+    void read_header(const std::string& path) {
+        const char* bytes = static_cast<const char*>(data_);
+        SnapshotHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (header.magic != SnapshotHeader::MAGIC || header.byte_order != 1) {
+            throw std::runtime_error("snapshot " + path + ": not a snapshot of this machine");
+        }
+        if (header.version != SnapshotHeader::VERSION || header.record_size != sizeof(record_type) ||
+            header.record_align != alignof(record_type)) {
+            throw std::runtime_error("snapshot " + path + ": another version or record type");
+        }
+        // num_of_cells is bounded by the file size first, so that the end of the offsets does not overflow.
+        if (header.num_of_cells == 0 || header.offsets_offset > file_size_ ||
+            header.num_of_cells >= (file_size_ - header.offsets_offset) / sizeof(uint64_t)) {
+            throw std::runtime_error("snapshot " + path + ": corrupted header");
+        }
+        uint64_t offsets_end = header.offsets_offset + (header.num_of_cells + 1) * sizeof(uint64_t);
+        if (header.offsets_offset % alignof(uint64_t) != 0 ||
+            header.records_offset % alignof(record_type) != 0 || offsets_end > header.records_offset ||
+            header.records_offset > file_size_ ||
+            header.size > (file_size_ - header.records_offset) / sizeof(record_type)) {
+            throw std::runtime_error("snapshot " + path + ": corrupted header");
+        }
+        if (CapacityPolicy::round_up(header.num_of_cells) != header.num_of_cells) {
+            throw std::runtime_error("snapshot " + path + ": written with another hash or capacity policy");
+        }
+        offsets_ = reinterpret_cast<const uint64_t*>(bytes + header.offsets_offset);
+        records_ = reinterpret_cast<const record_type*>(bytes + header.records_offset);
+        num_of_cells_ = header.num_of_cells;
+        size_ = header.size;
+        capacity_policy_.reset(num_of_cells_);
+        if (offsets_[0] != 0 || offsets_[num_of_cells_] != size_) {
+            throw std::runtime_error("snapshot " + path + ": corrupted offsets");
+        }
+        for (size_t cell = 0; cell < num_of_cells_; ++cell) {
+            if (offsets_[cell + 1] < offsets_[cell] || offsets_[cell + 1] > size_) {
+                throw std::runtime_error("snapshot " + path + ": corrupted offsets");
+            }
+        }
+        if (size_ > 0) {
+            size_t cell = 0;
+            while (offsets_[cell + 1] == 0) {
+                cell++;
+            }
+            if (hasher_(records_[0].first) != records_[0].hash || capacity_policy_.index(records_[0].hash) != cell) {
+                throw std::runtime_error("snapshot " + path + ": written with another hash or capacity policy");
+            }
+        }
+    }
+
+  private:
+    Hash hasher_;
+    KeyEqual key_equal_;
+    void* data_ = nullptr;
+    size_t file_size_ = 0;
+    // Both point into the mapping.
+    const uint64_t* offsets_ = nullptr;
+    const record_type* records_ = nullptr;
+    size_t num_of_cells_ = 0;
+    size_t size_ = 0;
+    CapacityPolicy capacity_policy_;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Slab allocator for the nodes of one container.
+   Nodes are cut from contiguous chunks, chunk size doubles up to MAX_CHUNK_BYTES.
+   Destroyed nodes go to a free list and are reused by the next create().
+   Nodes never move, so pointers to them stay valid until destroy().
+   Not thread safe: the pool belongs to one container.
+   Chunks are taken from Allocator (rebound to the chunk cells), nodes are constructed and destroyed
+   through it, so a std::pmr allocator also passes its memory resource to the elements. */
+template<class T, class Allocator = std::allocator<T>>
+class NodePool {
+    union Cell;
+
+  public:
+    // Number of nodes in the first chunk.
+    static const size_t MIN_CHUNK_SIZE;
+    // Upper bound for the size of one chunk in bytes (but at least one node per chunk).
+    static const size_t MAX_CHUNK_BYTES;
+
+    explicit NodePool(const Allocator& allocator = Allocator()):
+                      allocator_(allocator), chunks_(chunk_allocator(allocator)) {}
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    NodePool(NodePool&& other): allocator_(other.allocator_), chunks_(chunk_allocator(other.allocator_)) {
+        swap(other);
+    }
+
+    ~NodePool() {
+        clear();
+    }
+
+    NodePool& operator=(NodePool&& other) {
+        swap(other);
+        return *this;
+    }
+
+    // Allocators are swapped only if they propagate on swap, otherwise they must be equal.
+    void swap(NodePool& other) {
+        swap_allocators(other, typename allocator_traits::propagate_on_container_swap());
+        chunks_.swap(other.chunks_);
+        std::swap(free_list_, other.free_list_);
+        std::swap(next_cell_, other.next_cell_);
+        std::swap(end_cell_, other.end_cell_);
+        std::swap(next_chunk_size_, other.next_chunk_size_);
+    }
+
+    Allocator get_allocator() const {
+        return allocator_;
+    }
+
+    // Allocates a node and constructs T from args in it.
+    template<class... Args>
+    T* create(Args&&... args) {
+        Cell* cell = allocate();
+        try {
+            T* node = reinterpret_cast<T*>(cell->storage);
+            allocator_traits::construct(allocator_, node, std::forward<Args>(args)...);
+            return node;
+        } catch (...) {
+            release(cell);
+            throw;
+        }
+    }
+
+    // Destroys the node and puts its memory to the free list.
+    void destroy(T* node) {
+        allocator_traits::destroy(allocator_, node);
+        release(reinterpret_cast<Cell*>(node));
+    }
+
+    /* Contiguous nodes taken at once by allocate_run(), so that several threads
+       can construct nodes in it without touching the pool. */
+    class Run {
+      public:
+        size_t size() const {
+            return size_;
+        }
+
+      private:
+        friend class NodePool;
+
+        Cell* cells_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Allocates a chunk of exactly size nodes for a bulk construction.
+    Run allocate_run(size_t size) {
+        Run run;
+        if (size == 0) {
+            return run;
+        }
+        cell_allocator allocator(allocator_);
+        run.cells_ = cell_traits::allocate(allocator, size);
+        try {
+            chunks_.push_back(Chunk{run.cells_, size});
+        } catch (...) {
+            cell_traits::deallocate(allocator, run.cells_, size);
+            throw;
+        }
+        run.size_ = size;
+        return run;
+    }
+
+    /* Constructs T from args in the node number index of the run.
+       Different nodes may be constructed from different threads at once if the allocator
+       is stateless (std::allocator_traits<Allocator>::is_always_equal), nothing else of the pool is touched. */
+    template<class... Args>
+    T* create_in(const Run& run, size_t index, Args&&... args) {
+        Allocator allocator(allocator_);
+        T* node = reinterpret_cast<T*>(run.cells_[index].storage);
+        allocator_traits::construct(allocator, node, std::forward<Args>(args)...);
+        return node;
+    }
+
+    // Puts never constructed nodes [first; size) of the run to the free list.
+    void release_run(const Run& run, size_t first) {
+        for (size_t index = first; index < run.size_; ++index) {
+            release(&run.cells_[index]);
+        }
+    }
+
+    // Memory of all chunks, taken by live nodes, free nodes and the never used tail.
+    size_t allocated_bytes() const {
+        size_t num_of_cells = 0;
+        for (const auto& chunk : chunks_) {
+            num_of_cells += chunk.size;
+        }
+        return num_of_cells * sizeof(Cell);
+    }
+
+    /* Frees all chunks at once.
+       All nodes must be destroyed before, memory of live nodes is lost. */
+    void clear() {
+        cell_allocator allocator(allocator_);
+        for (const auto& chunk : chunks_) {
+            cell_traits::deallocate(allocator, chunk.cells, chunk.size);
+        }
+        chunks_.clear();
+        free_list_ = nullptr;
+        next_cell_ = nullptr;
+        end_cell_ = nullptr;
+        next_chunk_size_ = NodePool::MIN_CHUNK_SIZE;
+    }
+
+  private:
+    union Cell {
+        Cell* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    using allocator_traits = std::allocator_traits<Allocator>;
+    using cell_allocator = typename allocator_traits::template rebind_alloc<Cell>;
+    using cell_traits = std::allocator_traits<cell_allocator>;
+
+    struct Chunk {
+        Cell* cells;
+        size_t size;
+    };
+    using chunk_allocator = typename allocator_traits::template rebind_alloc<Chunk>;
+
+    Cell* allocate() {
+        if (free_list_ != nullptr) {
+            Cell* cell = free_list_;
+            free_list_ = cell->next;
+            return cell;
+        }
+        if (next_cell_ == end_cell_) {
+            add_chunk();
+        }
+        return next_cell_++;
+    }
+
+    void release(Cell* cell) {
+        cell->next = free_list_;
+        free_list_ = cell;
+    }
+
+    void add_chunk() {
+        size_t max_chunk_size = std::max<size_t>(1, NodePool::MAX_CHUNK_BYTES / sizeof(Cell));
+        size_t chunk_size = std::min(next_chunk_size_, max_chunk_size);
+        cell_allocator allocator(allocator_);
+        Cell* cells = cell_traits::allocate(allocator, chunk_size);
+        try {
+            chunks_.push_back(Chunk{cells, chunk_size});
+        } catch (...) {
+            cell_traits::deallocate(allocator, cells, chunk_size);
+            throw;
+        }
+        next_cell_ = cells;
+        end_cell_ = next_cell_ + chunk_size;
+        next_chunk_size_ = chunk_size * 2;
+    }
+
+    void swap_allocators(NodePool& other, std::true_type) {
+        std::swap(allocator_, other.allocator_);
+    }
+
+    void swap_allocators(NodePool&, std::false_type) {}
+
+  private:
+    Allocator allocator_;
+    std::vector<Chunk, chunk_allocator> chunks_;
+    // Destroyed nodes, linked through Cell::next.
+    Cell* free_list_ = nullptr;
+    // Never used part of the last chunk.
+    Cell* next_cell_ = nullptr;
+    Cell* end_cell_ = nullptr;
+    size_t next_chunk_size_ = NodePool::MIN_CHUNK_SIZE;
+};
+
+template<class T, class Allocator>
+constexpr size_t NodePool<T, Allocator>::MIN_CHUNK_SIZE = 32;
+
+template<class T, class Allocator>
+constexpr size_t NodePool<T, Allocator>::MAX_CHUNK_BYTES = 1 << 20;
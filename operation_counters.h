@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+/* Instrumentation policies of HashMap: counters of the work done by its operations.
+   Interface of a policy:
+      1. void hashed(size_t n) - n calls of the hash function.
+      2. void compared(size_t n) - n calls of KeyEqual.
+      3. void probed(size_t n) - n entries of cells looked at while searching for a key.
+      4. void allocated(size_t n) - n nodes constructed in the pool.
+      5. void merge(const Policy& other) - adds counters collected by a parallel pass.
+   The policy is called from const methods too, HashMap keeps it in InstrumentationStorage. */
+
+/* Default policy: does nothing, every call is an empty inline function
+   and disappears from the compiled code. */
+struct NoOperationCounters {
+    void hashed(size_t) {}
+    void compared(size_t) {}
+    void probed(size_t) {}
+    void allocated(size_t) {}
+    void merge(const NoOperationCounters&) {}
+};
+
+/* Plain counters, read them by HashMap::operation_counters().
+   Not atomic: even const lookups write them, so a table with these counters
+   must not be read from several threads at once. */
+struct OperationCounters {
+    size_t hashes = 0;
+    size_t compares = 0;
+    size_t probes = 0;
+    size_t allocations = 0;
+
+    void hashed(size_t n) {
+        hashes += n;
+    }
+
+    void compared(size_t n) {
+        compares += n;
+    }
+
+    void probed(size_t n) {
+        probes += n;
+    }
+
+    void allocated(size_t n) {
+        allocations += n;
+    }
+
+    void merge(const OperationCounters& other) {
+        hashes += other.hashes;
+        compares += other.compares;
+        probes += other.probes;
+        allocations += other.allocations;
+    }
+
+    void reset() {
+        *this = OperationCounters();
+    }
+};
+
+/* Policy of a HashMap, which derives from this storage privately: counters() is the only name added.
+   An empty policy (NoOperationCounters) is a base class, so it takes no space in the table,
+   other policies are a mutable member. Both are written through counters() by const methods. */
+template<class Instrumentation,
+         bool Empty = std::is_empty<Instrumentation>::value && !std::is_final<Instrumentation>::value>
+class InstrumentationStorage {
+  protected:
+    Instrumentation& counters() const {
+        return counters_;
+    }
+
+  private:
+    mutable Instrumentation counters_;
+};
+
+template<class Instrumentation>
+class InstrumentationStorage<Instrumentation, true> : private Instrumentation {
+  protected:
+    // The policy has no state, so casting const away can't change an object.
+    Instrumentation& counters() const {
+        return const_cast<InstrumentationStorage&>(*this);
+    }
+};
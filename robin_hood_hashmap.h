@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_functions.h"
+#include "map_slot.h"
+
+/* Hashtable with open addressing and Robin Hood linear probing.
+   Same interface as HashMap. Every slot keeps the distance to the home slot of its element,
+   and insert takes the slot from an element which is closer to its home ("richer"),
+   so probe lengths stay short and even.
+   Erase shifts the following elements one slot back instead of leaving tombstones,
+   so a long churn of inserts and erases does not degrade lookups and never rebuilds the table.
+   Probe length is bounded by MAX_DISTANCE: if an insert would exceed it, the table grows.
+   If it would still exceed it with load factor below 1/8, too many keys share a hash
+   (a degenerate Hash) and insert throws std::runtime_error instead of growing without end.
+   Insert and erase may move elements, so they invalidate iterators and references.
+   Elements are swapped along the cluster, where a failed move can't be undone, so their
+   move constructor must not throw.
+   Complexity is amortized O(1) for a query.
+   Memory is linear from number of elements inside the table. */
+template<class KeyType, class ValueType, class Hash = DefaultHash<KeyType> >
+class RobinHoodHashMap {
+  public:
+    // Minimal number of slots (power of two). Also used for initialization.
+    static const size_t MIN_NUM_OF_CELLS;
+    // Maximal distance from the home slot.
+    static const size_t MAX_DISTANCE;
+
+    using value_type = std::pair<const KeyType, ValueType>;
+
+    static_assert(std::is_nothrow_move_constructible<std::pair<KeyType, ValueType>>::value,
+                  "RobinHoodHashMap moves elements between slots, their move must not throw");
+
+    class iterator;
+    class const_iterator;
+
+    RobinHoodHashMap(): hasher_() {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+    }
+
+    RobinHoodHashMap(const Hash& hash_function): hasher_(hash_function) {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+    }
+
+    template<class ForwardIterator>
+    RobinHoodHashMap(ForwardIterator begin, ForwardIterator end, const Hash& hash_function = Hash()):
+                                                                         hasher_(hash_function) {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+        while (begin != end) {
+            insert(*begin);
+            ++begin;
+        }
+    }
+
+    RobinHoodHashMap(std::initializer_list<std::pair<KeyType, ValueType>> initializer_list,
+                     Hash hash_function = Hash()): hasher_(hash_function) {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+        for (auto it = initializer_list.begin(); it != initializer_list.end(); ++it) {
+            insert(*it);
+        }
+    }
+
+    RobinHoodHashMap(const RobinHoodHashMap& other): hasher_(other.hasher_) {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+        for (const auto& element : other) {
+            insert(element);
+        }
+    }
+
+    RobinHoodHashMap(RobinHoodHashMap&& other): hasher_(other.hasher_) {
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+        swap(other);
+    }
+
+    RobinHoodHashMap& operator=(const RobinHoodHashMap& other) {
+        if (this != &other) {
+            RobinHoodHashMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    RobinHoodHashMap& operator=(RobinHoodHashMap&& other) {
+        swap(other);
+        return *this;
+    }
+
+    ~RobinHoodHashMap() {
+        destroy_elements();
+    }
+
+    void swap(RobinHoodHashMap& other) {
+        std::swap(hasher_, other.hasher_);
+        distance_.swap(other.distance_);
+        slots_.swap(other.slots_);
+        std::swap(current_size_, other.current_size_);
+        std::swap(shift_, other.shift_);
+    }
+
+    /* Insert an element into the hashtable by its key.
+       If key is already present, do nothing.
+       If load factor becomes more than 0.9 or probe length exceeds MAX_DISTANCE,
+       table grows in O(total_size) time.
+       If the element or the table growth throws, the table does not change. */
+    void insert(const std::pair<const KeyType, ValueType> &pair) {
+        size_t hash = hasher_(pair.first);
+        if (find_position(pair.first, hash) != capacity()) {
+            return;
+        }
+        prepare_place(hash);
+        Slot carry;
+        carry.construct(pair);
+        place(carry, hash);
+    }
+
+    /* Erase element by key. If key not found, do nothing.
+       Following elements of the cluster are shifted one slot back,
+       complexity is linear from the cluster length, which is bounded by MAX_DISTANCE. */
+    void erase(const KeyType& key) {
+        size_t position = find_position(key, hasher_(key));
+        if (position != capacity()) {
+            erase_at(position);
+        }
+    }
+
+    // Return iterator for an element by key. Returns end() if key not found.
+    iterator find(const KeyType& key) {
+        return iterator(this, find_position(key, hasher_(key)));
+    }
+
+    // Return const_iterator for an element by key. Returns end() if key not found.
+    const_iterator find(const KeyType& key) const {
+        return const_iterator(this, find_position(key, hasher_(key)));
+    }
+
+    size_t size() const {
+        return current_size_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Clear the hashtable
+       Complexity is linear from capacity. */
+    void clear() {
+        destroy_elements();
+        init(RobinHoodHashMap::MIN_NUM_OF_CELLS);
+    }
+
+    Hash hash_function() const {
+        return hasher_;
+    }
+
+    // Returns an iterator which points to first element.
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    // Returns an iterator which points after last slot.
+    iterator end() {
+        return iterator(this, capacity());
+    }
+
+    // Returns an iterator which points to first element.
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    // Returns an iterator which points after last slot.
+    const_iterator end() const {
+        return const_iterator(this, capacity());
+    }
+
+    /* Return a value by key.
+       If key not found, creates new element in hashtable with default value. */
+    ValueType& operator[](const KeyType& key) {
+        return subscript_key(key);
+    }
+
+    ValueType& operator[](KeyType&& key) {
+        return subscript_key(std::move(key));
+    }
+
+    /* Return a value by key.
+       If key not found, throws std::out_of_range. */
+    const ValueType& at(const KeyType& key) const {
+        size_t position = find_position(key, hasher_(key));
+        if (position == capacity()) {
+            throw std::out_of_range("ooops, your key is not found");
+        }
+        return slots_[position].value.second;
+    }
+
+    /* Iterator for the hash map
+       Contains pointer to the RobinHoodHashMap object and index of the slot.
+       Always points to a full slot, or to capacity() for end. */
+    class iterator {
+      public:
+        iterator() {}
+
+        iterator(RobinHoodHashMap *outer, size_t position = 0): outer(outer), position(position) {
+            find_full_slot();
+        }
+
+        iterator operator++() {
+            position++;
+            find_full_slot();
+            return (*this);
+        }
+
+        iterator operator++(int) {
+            iterator result = (*this);
+            ++(*this);
+            return result;
+        }
+
+        std::pair<const KeyType, ValueType>& operator*() const {
+            return outer->slots_[position].value;
+        }
+
+        std::pair<const KeyType, ValueType>* operator->() const {
+            return &outer->slots_[position].value;
+        }
+
+        bool operator==(const iterator& other) const {
+            return std::tie(position, outer) == std::tie(other.position, other.outer);
+        }
+
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+      private:
+        // Moves iterator to next full slot (or to end).
+        void find_full_slot() {
+            while (position < outer->capacity() && outer->distance_[position] == 0) {
+                position++;
+            }
+        }
+
+      private:
+        RobinHoodHashMap *outer = nullptr;
+        size_t position;
+    };
+
+    /* Const iterator for the hash map
+       Contains pointer to the RobinHoodHashMap object and index of the slot.
+       Always points to a full slot, or to capacity() for end. */
+    class const_iterator {
+      public:
+        const_iterator() {}
+
+        const_iterator(const RobinHoodHashMap *outer, size_t position = 0): outer(outer), position(position) {
+            find_full_slot();
+        }
+
+        const_iterator operator++() {
+            position++;
+            find_full_slot();
+            return (*this);
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = (*this);
+            ++(*this);
+            return result;
+        }
+
+        const std::pair<const KeyType, ValueType>& operator*() const {
+            return outer->slots_[position].value;
+        }
+
+        const std::pair<const KeyType, ValueType>* operator->() const {
+            return &outer->slots_[position].value;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return std::tie(position, outer) == std::tie(other.position, other.outer);
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+      private:
+        // Moves iterator to next full slot (or to end).
+        void find_full_slot() {
+            while (position < outer->capacity() && outer->distance_[position] == 0) {
+                position++;
+            }
+        }
+
+      private:
+        const RobinHoodHashMap *outer = nullptr;
+        size_t position;
+    };
+
+  private:
+    using Slot = MapSlot<KeyType, ValueType>;
+
+    size_t capacity() const {
+        return distance_.size();
+    }
+
+    // Fibonacci hashing: high bits of the product choose the home slot.
+    size_t home(size_t hash) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    size_t next(size_t position) const {
+        return (position + 1) & (capacity() - 1);
+    }
+
+    // Allocates capacity empty slots (must be a power of two).
+    void init(size_t capacity) {
+        distance_.assign(capacity, 0);
+        slots_.reset(new Slot[capacity]);
+        current_size_ = 0;
+        update_shift();
+    }
+
+    void update_shift() {
+        shift_ = 64;
+        while ((size_t(1) << (64 - shift_)) < capacity()) {
+            shift_--;
+        }
+    }
+
+    void destroy_elements() {
+        for (size_t i = 0; i < capacity(); ++i) {
+            if (distance_[i] != 0) {
+                slots_[i].destroy();
+            }
+        }
+    }
+
+    /* Returns position of the key or capacity() if key not found.
+       distance_ stores distance from home plus one, 0 means empty.
+       The key can only be in a slot with the same distance, and the search stops
+       at the first slot whose element is closer to its home than we are to ours. */
+    size_t find_position(const KeyType& key, size_t hash) const {
+        size_t position = home(hash);
+        for (size_t distance = 1; distance <= distance_[position]; ++distance) {
+            if (distance_[position] == distance && slots_[position].value.first == key) {
+                return position;
+            }
+            position = next(position);
+        }
+        return capacity();
+    }
+
+    // operator[] for a copied or a moved key.
+    template<class K>
+    ValueType& subscript_key(K&& key) {
+        size_t hash = hasher_(key);
+        size_t position = find_position(key, hash);
+        if (position == capacity()) {
+            prepare_place(hash);
+            Slot carry;
+            carry.construct(std::forward<K>(key), ValueType());
+            position = place(carry, hash);
+        }
+        return slots_[position].value.second;
+    }
+
+    /* Whether an element with given hash can be placed without carrying any element
+       further than MAX_DISTANCE. Walks the same slots as place(), but moves nothing. */
+    bool fits(size_t hash) const {
+        size_t position = home(hash);
+        size_t distance = 1;
+        while (distance <= RobinHoodHashMap::MAX_DISTANCE) {
+            if (distance_[position] == 0) {
+                return true;
+            }
+            if (distance_[position] < distance) {
+                distance = distance_[position];
+            }
+            position = next(position);
+            distance++;
+        }
+        return false;
+    }
+
+    /* Grows the table until an element with given hash fits into it, before the element is
+       constructed: then place() neither rebuilds nor throws, and an exception leaves the table as it was.
+       Throws std::runtime_error if the probe length overflows in a table with load factor below 1/8. */
+    void prepare_place(size_t hash) {
+        if ((size() + 1) * 10 > capacity() * 9) {
+            rebuild(capacity() * 2);
+        }
+        while (!fits(hash)) {
+            if (size() * 8 < capacity()) {
+                throw std::runtime_error("RobinHoodHashMap: more than MAX_DISTANCE keys share a hash");
+            }
+            rebuild(capacity() * 2);
+        }
+    }
+
+    /* Puts the element from carry (key must be absent) into the table and returns its position.
+       The element must fit: after prepare_place(), or while rebuild() moves the elements of a fitting
+       table into a twice larger one, where home slots keep their order and no distance grows. */
+    size_t place(Slot& carry, size_t hash) {
+        size_t result = capacity();
+        size_t position = home(hash);
+        size_t distance = 1;
+        while (true) {
+            assert(distance <= RobinHoodHashMap::MAX_DISTANCE && current_size_ < capacity());
+            if (distance_[position] == 0) {
+                slots_[position].transfer_from(carry);
+                distance_[position] = static_cast<uint8_t>(distance);
+                current_size_++;
+                return result == capacity() ? position : result;
+            }
+            if (distance_[position] < distance) {
+                // Take the slot from a richer element and carry that one further.
+                Slot tmp;
+                tmp.transfer_from(slots_[position]);
+                slots_[position].transfer_from(carry);
+                carry.transfer_from(tmp);
+                size_t displaced = distance_[position];
+                distance_[position] = static_cast<uint8_t>(distance);
+                distance = displaced;
+                if (result == capacity()) {
+                    result = position;
+                }
+            }
+            position = next(position);
+            distance++;
+        }
+    }
+
+    // Backward shift deletion: moves the rest of the cluster one slot closer to home.
+    void erase_at(size_t position) {
+        slots_[position].destroy();
+        current_size_--;
+        size_t following = next(position);
+        while (distance_[following] > 1) {
+            slots_[position].transfer_from(slots_[following]);
+            distance_[position] = static_cast<uint8_t>(distance_[following] - 1);
+            position = following;
+            following = next(following);
+        }
+        distance_[position] = 0;
+    }
+
+    /* Stop the world: moves all elements into a table with new_capacity slots.
+       New slots are allocated before the old ones are touched, so a failed allocation
+       leaves the table as it was. Moves don't throw, so only the hash function can fail
+       after that: then the table keeps the elements moved so far and destroys the others.
+       Complexity is O(capacity). */
+    void rebuild(size_t new_capacity) {
+        std::vector<uint8_t> old_distance(new_capacity, 0);
+        std::unique_ptr<Slot[]> old_slots(new Slot[new_capacity]);
+        old_distance.swap(distance_);
+        old_slots.swap(slots_);
+        current_size_ = 0;
+        update_shift();
+        size_t i = 0;
+        try {
+            for (; i < old_distance.size(); ++i) {
+                if (old_distance[i] != 0) {
+                    place(old_slots[i], hasher_(old_slots[i].value.first));
+                }
+            }
+        } catch (...) {
+            for (; i < old_distance.size(); ++i) {
+                if (old_distance[i] != 0) {
+                    old_slots[i].destroy();
+                }
+            }
+            throw;
+        }
+    }
+
+  private:
+    Hash hasher_;
+    // Distance from home slot plus one, 0 for empty slot.
+    std::vector<uint8_t> distance_;
+    std::unique_ptr<Slot[]> slots_;
+
+    size_t current_size_ = 0;
+    // home(hash) takes 64 - shift_ high bits of the product.
+    unsigned shift_ = 64;
+};
+
+template<class KeyType, class ValueType, class Hash>
+constexpr size_t RobinHoodHashMap<KeyType, ValueType, Hash>::MIN_NUM_OF_CELLS = 16;
+
+template<class KeyType, class ValueType, class Hash>
+constexpr size_t RobinHoodHashMap<KeyType, ValueType, Hash>::MAX_DISTANCE = 128;
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* Binary streams of HashMap::serialize() and deserialize().
+   Data goes in chunks: a uint64_t length, then that many bytes, and a chunk of length 0 ends
+   the stream. A reader takes exactly the chunks of its stream, so other data may follow it
+   in the same std::istream. Numbers are in the byte order of the machine. */
+class StreamWriter {
+  public:
+    // Maximal length of a chunk, bytes are collected in memory until a chunk is full.
+    static const size_t CHUNK_SIZE;
+
+    explicit StreamWriter(std::ostream& out): out_(out) {
+        buffer_.reserve(StreamWriter::CHUNK_SIZE);
+    }
+
+    StreamWriter(const StreamWriter&) = delete;
+    StreamWriter& operator=(const StreamWriter&) = delete;
+
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            size_t part = std::min(size, StreamWriter::CHUNK_SIZE - buffer_.size());
+            buffer_.insert(buffer_.end(), bytes, bytes + part);
+            bytes += part;
+            size -= part;
+            if (buffer_.size() == StreamWriter::CHUNK_SIZE) {
+                write_chunk();
+            }
+        }
+    }
+
+    /* Writes the collected bytes and the end of the stream.
+       Must be called once after the last write(), bytes are lost otherwise. */
+    void finish() {
+        if (!buffer_.empty()) {
+            write_chunk();
+        }
+        write_chunk();
+        out_.flush();
+        check();
+    }
+
+  private:
+    void write_chunk() {
+        uint64_t length = buffer_.size();
+        out_.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        check();
+        buffer_.clear();
+    }
+
+    void check() {
+        if (!out_) {
+            throw std::runtime_error("serialization: can't write to the stream");
+        }
+    }
+
+  private:
+    std::ostream& out_;
+    std::vector<char> buffer_;
+};
+
+class StreamReader {
+  public:
+    explicit StreamReader(std::istream& in): in_(in) {}
+
+    StreamReader(const StreamReader&) = delete;
+    StreamReader& operator=(const StreamReader&) = delete;
+
+    // Throws std::runtime_error if the stream ends first.
+    void read(void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            if (position_ == buffer_.size() && !read_chunk()) {
+                throw std::runtime_error("serialization: stream ended too early");
+            }
+            size_t part = std::min(size, buffer_.size() - position_);
+            std::memcpy(bytes, buffer_.data() + position_, part);
+            position_ += part;
+            bytes += part;
+            size -= part;
+        }
+    }
+
+    // Reads the end of the stream, throws std::runtime_error if there are unread bytes.
+    void finish() {
+        if (position_ != buffer_.size() || read_chunk()) {
+            throw std::runtime_error("serialization: unexpected data at the end of the stream");
+        }
+    }
+
+    /* Bytes left to read at most: the rest of the current chunk and of the std::istream,
+       lengths of the chunks and data after the stream included. Max uint64_t if the std::istream
+       can't tell its size (e.g. a pipe). The position of the std::istream is kept. */
+    uint64_t available() {
+        const uint64_t unknown = std::numeric_limits<uint64_t>::max();
+        std::streampos here = in_.tellg();
+        if (here == std::streampos(-1)) {
+            return unknown;
+        }
+        in_.seekg(0, std::ios::end);
+        std::streampos end = in_.tellg();
+        in_.clear();
+        in_.seekg(here);
+        if (!in_ || end == std::streampos(-1) || end < here) {
+            in_.clear();
+            return unknown;
+        }
+        return (buffer_.size() - position_) + static_cast<uint64_t>(end - here);
+    }
+
+  private:
+    // Returns false at the end of the stream.
+    bool read_chunk() {
+        uint64_t length = 0;
+        in_.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (!in_ || length > StreamWriter::CHUNK_SIZE) {
+            throw std::runtime_error("serialization: corrupted stream");
+        }
+        buffer_.resize(length);
+        in_.read(buffer_.data(), static_cast<std::streamsize>(length));
+        if (!in_) {
+            throw std::runtime_error("serialization: stream ended too early");
+        }
+        position_ = 0;
+        return length > 0;
+    }
+
+  private:
+    std::istream& in_;
+    std::vector<char> buffer_;
+    size_t position_ = 0;
+};
+
+inline constexpr size_t StreamWriter::CHUNK_SIZE = 1 << 16;
+
+/* How keys and values are written, the customization point of serialization:
+   specialize Serializer<T> with
+      static void write(StreamWriter& writer, const T& value);
+      static T read(StreamReader& reader);
+   and optionally static constexpr size_t MIN_SIZE, the least number of bytes written for a value.
+   Trivially copyable types (default constructible ones) are written as bytes,
+   strings as their length and characters. */
+template<class T, class Enable = void>
+struct Serializer;
+
+/* MIN_SIZE of Serializer<T>, 1 if it has none. deserialize() divides the bytes left in a stream
+   by it to bound the number of elements which a header may claim. */
+template<class T, class Enable = void>
+struct SerializedMinSize : std::integral_constant<size_t, 1> {};
+
+template<class T>
+struct SerializedMinSize<T, std::void_t<decltype(Serializer<T>::MIN_SIZE)>>
+        : std::integral_constant<size_t, Serializer<T>::MIN_SIZE> {};
+
+template<class T>
+struct Serializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+    static constexpr size_t MIN_SIZE = sizeof(T);
+
+    static void write(StreamWriter& writer, const T& value) {
+        writer.write(&value, sizeof(T));
+    }
+
+    static T read(StreamReader& reader) {
+        T value;
+        reader.read(&value, sizeof(T));
+        return value;
+    }
+};
+
+template<class CharT, class Traits, class Allocator>
+struct Serializer<std::basic_string<CharT, Traits, Allocator>> {
+    static constexpr size_t MIN_SIZE = sizeof(uint64_t);
+
+    static void write(StreamWriter& writer, const std::basic_string<CharT, Traits, Allocator>& value) {
+        uint64_t length = value.size();
+        writer.write(&length, sizeof(length));
+        writer.write(value.data(), value.size() * sizeof(CharT));
+    }
+
+    static std::basic_string<CharT, Traits, Allocator> read(StreamReader& reader) {
+        uint64_t length = 0;
+        reader.read(&length, sizeof(length));
+        std::basic_string<CharT, Traits, Allocator> value;
+        // Grows with the data read, so a corrupted length fails on the end of the stream, not on allocation.
+        while (value.size() < length) {
+            size_t part = static_cast<size_t>(std::min<uint64_t>(length - value.size(), StreamWriter::CHUNK_SIZE));
+            size_t old_size = value.size();
+            value.resize(old_size + part);
+            reader.read(&value[old_size], part * sizeof(CharT));
+        }
+        return value;
+    }
+};
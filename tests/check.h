@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/* CHECK(condition): like assert, but not removed by NDEBUG, and the condition may contain commas.
+   Prints the failed condition with its place and exits with code 1. */
+#define CHECK(...)                                                                               \
+    do {                                                                                         \
+        if (!(__VA_ARGS__)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+            std::exit(1);                                                                        \
+        }                                                                                        \
+    } while (false)
@@ -0,0 +1,84 @@
+/* ConcurrentHashMap: operations of one thread against std::unordered_map, and counters
+   incremented by several threads at once, which lose no increment and no key.
+   Build and run: make concurrent_hashmap_test && ./concurrent_hashmap_test */
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../concurrent_hashmap.h"
+#include "check.h"
+
+void single_thread() {
+    ConcurrentHashMap<uint64_t, uint64_t> map(8);
+    CHECK(map.num_of_shards() == 8);
+    std::unordered_map<uint64_t, uint64_t> expected;
+    std::mt19937_64 rng(1);
+    for (uint64_t op = 0; op < 200000; ++op) {
+        uint64_t key = rng() % 5000;
+        switch (rng() % 5) {
+            case 0:
+                CHECK(map.insert({key, op}) == expected.insert({key, op}).second);
+                break;
+            case 1:
+                CHECK(map.insert_or_assign(key, op) == (expected.count(key) == 0));
+                expected[key] = op;
+                break;
+            case 2:
+                CHECK(map.erase(key) == (expected.erase(key) == 1));
+                break;
+            case 3:
+                CHECK(map.update(key, [](uint64_t& value) { value++; }) == (expected.count(key) == 1));
+                if (expected.count(key) == 1) {
+                    expected[key]++;
+                }
+                break;
+            default:
+                auto found = map.find(key);
+                auto it = expected.find(key);
+                CHECK(found.has_value() == (it != expected.end()));
+                CHECK(!found || *found == it->second);
+                CHECK(map.contains(key) == found.has_value());
+        }
+    }
+    CHECK(map.size() == expected.size());
+    size_t visited = 0;
+    map.for_each([&](const std::pair<const uint64_t, uint64_t>& element) {
+        CHECK(expected.at(element.first) == element.second);
+        visited++;
+    });
+    CHECK(visited == expected.size());
+    map.clear();
+    CHECK(map.empty());
+}
+
+// Every thread adds 1 to every key, the counters end at the number of threads.
+void concurrent_counters() {
+    const size_t num_of_threads = 8;
+    const uint64_t num_of_keys = 20000;
+    ConcurrentHashMap<uint64_t, uint64_t> map(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_of_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint64_t i = 0; i < num_of_keys; ++i) {
+                uint64_t key = (i * 7919 + t * 104729) % num_of_keys;
+                map.upsert(key, [](uint64_t& value) { value++; }, 0);
+                map.find((key + 1) % num_of_keys);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(map.size() == num_of_keys);
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        CHECK(map.find(key) == num_of_threads);
+    }
+}
+
+int main() {
+    single_thread();
+    concurrent_counters();
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* ConstexprHashMap: built by the compiler from integer, enum and string_view keys, finds every key
+   and no other in constant expressions (static_assert), also when keys collide and probe further;
+   at runtime a repeated key and an absent key throw.
+   Build and run: make constexpr_hashmap_test && ./constexpr_hashmap_test */
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "../constexpr_hashmap.h"
+#include "check.h"
+
+using namespace std::string_view_literals;
+
+constexpr auto OPCODES = make_constexpr_hashmap<std::string_view, int>({
+    {"add", 1}, {"sub", 2}, {"mul", 3}, {"div", 4}, {"mod", 5}, {"and", 6}, {"or", 7},
+    {"xor", 8}, {"not", 9}, {"shl", 10}, {"shr", 11}, {"", 12},
+});
+
+static_assert(OPCODES.size() == 12 && !OPCODES.empty());
+static_assert(OPCODES.bucket_count() == 32);
+static_assert(OPCODES.at("add") == 1 && OPCODES.at("sub"sv) == 2 && OPCODES.at("shr") == 11);
+static_assert(OPCODES.at("") == 12);
+static_assert(OPCODES.find("xor")->first == "xor" && OPCODES.find("xor")->second == 8);
+static_assert(OPCODES.find("nop") == nullptr && OPCODES.find("ad") == nullptr && OPCODES.find("addd") == nullptr);
+static_assert(OPCODES.contains("mod") && !OPCODES.contains("MOD") && OPCODES.count("or") == 1 && OPCODES.count("o") == 0);
+
+constexpr auto SQUARES = make_constexpr_hashmap<int, long>({
+    {0, 0}, {1, 1}, {2, 4}, {3, 9}, {-4, 16}, {100, 10000}, {1 << 30, 0},
+});
+
+static_assert(SQUARES.at(3) == 9 && SQUARES.at(-4) == 16 && SQUARES.at(100) == 10000 && SQUARES.at(1 << 30) == 0);
+static_assert(!SQUARES.contains(4) && !SQUARES.contains(-1) && !SQUARES.contains(101));
+
+// Hash which puts every key into one of two cells, so keys probe past each other.
+struct ParityHash {
+    constexpr size_t operator()(int key) const {
+        return static_cast<size_t>(key & 1);
+    }
+};
+
+constexpr auto COLLIDING = make_constexpr_hashmap<int, int, ParityHash>({
+    {0, 10}, {2, 12}, {4, 14}, {1, 11}, {3, 13}, {5, 15}, {7, 17},
+});
+
+static_assert(COLLIDING.bucket_count() == 16);
+static_assert(COLLIDING.at(0) == 10 && COLLIDING.at(4) == 14 && COLLIDING.at(1) == 11 && COLLIDING.at(7) == 17);
+static_assert(!COLLIDING.contains(6) && !COLLIDING.contains(9) && !COLLIDING.contains(-2));
+
+enum class Color { RED, GREEN, BLUE, ALPHA };
+
+constexpr auto COLOR_NAMES = make_constexpr_hashmap<Color, std::string_view>({
+    {Color::RED, "red"}, {Color::GREEN, "green"}, {Color::BLUE, "blue"},
+});
+
+static_assert(COLOR_NAMES.at(Color::GREEN) == "green" && !COLOR_NAMES.contains(Color::ALPHA));
+
+constexpr ConstexprHashMap<int, int, 1> SINGLE({{42, 1}});
+
+static_assert(SINGLE.bucket_count() == 2 && SINGLE.at(42) == 1 && !SINGLE.contains(43));
+
+int main() {
+    // The same tables at runtime: a repeated key and an absent key throw instead of failing to compile.
+    bool thrown = false;
+    try {
+        std::pair<int, int> repeated[] = {{1, 1}, {2, 2}, {1, 3}};
+        ConstexprHashMap<int, int, 3> map(repeated);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        OPCODES.at("nop");
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::string_view key = "div";
+    CHECK(OPCODES.at(key) == 4);
+    return 0;
+}
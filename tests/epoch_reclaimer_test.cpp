@@ -0,0 +1,102 @@
+/* EpochReclaimer: a retired object is not freed while a guard entered before the retire is held,
+   is freed after the guard is left, and objects retired by exited threads are freed too.
+   Build and run: make epoch_reclaimer_test && ./epoch_reclaimer_test */
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include "../epoch_reclaimer.h"
+#include "check.h"
+
+// Object which counts its deletions.
+struct Tracked {
+    static std::atomic<size_t> deleted;
+
+    ~Tracked() {
+        deleted++;
+    }
+};
+
+std::atomic<size_t> Tracked::deleted{0};
+
+// Retires enough objects to advance the epoch several times.
+void retire_many(size_t count) {
+    EpochReclaimer& reclaimer = EpochReclaimer::instance();
+    for (size_t i = 0; i < count; ++i) {
+        reclaimer.retire(new int(0));
+    }
+}
+
+void guard_keeps_object() {
+    EpochReclaimer& reclaimer = EpochReclaimer::instance();
+    std::atomic<Tracked*> shared{new Tracked()};
+    std::atomic<bool> reading{false};
+    std::atomic<bool> done{false};
+    bool freed_under_guard = false;
+    std::thread reader([&] {
+        EpochReclaimer::Guard guard;
+        shared.load();
+        reading.store(true);
+        while (!done.load()) {
+            std::this_thread::yield();
+        }
+        freed_under_guard = Tracked::deleted.load() != 0;
+    });
+    while (!reading.load()) {
+        std::this_thread::yield();
+    }
+    Tracked* object = shared.exchange(nullptr);
+    reclaimer.retire(object);
+    retire_many(EpochReclaimer::RETIRE_BATCH * 10);
+    CHECK(Tracked::deleted.load() == 0);
+    done.store(true);
+    reader.join();
+    CHECK(!freed_under_guard);
+    retire_many(EpochReclaimer::RETIRE_BATCH * 10);
+    CHECK(Tracked::deleted.load() == 1);
+}
+
+void nested_guards() {
+    EpochReclaimer& reclaimer = EpochReclaimer::instance();
+    size_t before = Tracked::deleted.load();
+    std::atomic<bool> reading{false};
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        EpochReclaimer::Guard outer;
+        {
+            EpochReclaimer::Guard inner;
+        }
+        // Leaving the inner guard must not leave the epoch.
+        reading.store(true);
+        while (!done.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!reading.load()) {
+        std::this_thread::yield();
+    }
+    reclaimer.retire(new Tracked());
+    retire_many(EpochReclaimer::RETIRE_BATCH * 10);
+    CHECK(Tracked::deleted.load() == before);
+    done.store(true);
+    reader.join();
+    retire_many(EpochReclaimer::RETIRE_BATCH * 10);
+    CHECK(Tracked::deleted.load() == before + 1);
+}
+
+// Objects left in the record of an exited thread go to the orphans and are freed by other threads.
+void exited_thread() {
+    size_t before = Tracked::deleted.load();
+    std::thread([] {
+        EpochReclaimer::instance().retire(new Tracked());
+    }).join();
+    retire_many(EpochReclaimer::RETIRE_BATCH * 10);
+    CHECK(Tracked::deleted.load() == before + 1);
+}
+
+int main() {
+    guard_keeps_object();
+    nested_guards();
+    exited_thread();
+    return 0;
+}
@@ -0,0 +1,86 @@
+/* FlatHashMap: operations against std::unordered_map, tombstone churn, copies,
+   and exception safety of insert(), operator[] and of a growth whose allocation fails.
+   Build and run: make flat_hashmap_test && ./flat_hashmap_test */
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "../flat_hashmap.h"
+#include "map_checks.h"
+
+// While set, array new fails: slots of the table are the only arrays allocated by the test.
+bool fail_array_new = false;
+
+void* operator new[](size_t size) {
+    void* pointer = fail_array_new ? nullptr : std::malloc(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+/* Erases and inserts at a constant size: erased slots become tombstones in full groups,
+   the table must reuse them or rebuild in place instead of growing. */
+void check_churn() {
+    FlatHashMap<uint64_t, uint64_t> map;
+    const uint64_t size = 10000;
+    for (uint64_t key = 0; key < size; ++key) {
+        map.insert({key, key});
+    }
+    for (uint64_t key = size; key < 50 * size; ++key) {
+        map.erase(key - size);
+        map.insert({key, key});
+        CHECK(map.size() == size);
+    }
+    for (uint64_t key = 49 * size; key < 50 * size; ++key) {
+        CHECK(map.find(key) != map.end() && map.find(key)->second == key);
+    }
+    CHECK(map.find(0) == map.end());
+}
+
+// Inserts until the table grows with a failing allocation: the table keeps all its elements.
+void check_failed_growth() {
+    FlatHashMap<std::string, uint64_t> map;
+    std::unordered_map<std::string, uint64_t> expected;
+    bool thrown = false;
+    for (uint64_t i = 0; !thrown; ++i) {
+        std::string key = "key-with-a-long-heap-allocated-name-" + std::to_string(i);
+        fail_array_new = true;
+        try {
+            map.insert({key, i});
+            expected.insert({key, i});
+        } catch (const std::bad_alloc&) {
+            thrown = true;
+        }
+        fail_array_new = false;
+    }
+    CHECK(!expected.empty());
+    check_same_elements(map, expected);
+    map.insert({"after", 1});
+    expected.insert({"after", 1});
+    check_same_elements(map, expected);
+}
+
+int main() {
+    check_random_operations<FlatHashMap>(100, 20000);
+    check_random_operations<FlatHashMap>(20000, 300000);
+    check_string_keys<FlatHashMap>(20000);
+    check_copy_and_move<FlatHashMap>();
+    check_key_arguments<FlatHashMap>();
+    check_throwing_constructor<FlatHashMap>(20000);
+    CHECK(check_throwing_move<FlatHashMap, CopyableThrowingValue>(20000) > 0);
+    CHECK(check_throwing_move<FlatHashMap, MoveOnlyThrowingValue>(20000) > 0);
+    CHECK(check_throwing_hash<FlatHashMap>(20000) > 0);
+    check_churn();
+    check_failed_growth();
+    return 0;
+}
@@ -0,0 +1,80 @@
+/* FrozenHashMap: built by HashMap::freeze() and from a range, finds every key and no other,
+   and rejects repeated keys and different keys with equal hashes.
+   Build and run: make frozen_hashmap_test && ./frozen_hashmap_test */
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../hashtable.h"
+#include "check.h"
+
+// Hash which gives keys 0 and 1 the same value.
+struct CollidingHash {
+    size_t operator()(uint64_t key) const {
+        return std::hash<uint64_t>()(key < 2 ? 0 : key);
+    }
+};
+
+void from_hashmap(size_t num_of_keys) {
+    HashMap<std::string, uint64_t> map;
+    for (uint64_t i = 0; i < num_of_keys; ++i) {
+        map.insert({"key-" + std::to_string(i * 3), i});
+    }
+    auto frozen = map.freeze();
+    CHECK(frozen.size() == num_of_keys);
+    for (uint64_t i = 0; i < num_of_keys; ++i) {
+        std::string key = "key-" + std::to_string(i * 3);
+        CHECK(frozen.find(key) != nullptr && frozen.find(key)->second == i);
+        CHECK(frozen.at(key) == i);
+        CHECK(!frozen.contains("key-" + std::to_string(i * 3 + 1)));
+    }
+    size_t iterated = 0;
+    for (const auto& element : frozen) {
+        CHECK(map.at(element.first) == element.second);
+        iterated++;
+    }
+    CHECK(iterated == num_of_keys);
+}
+
+template<class Exception, class Hash>
+bool build_throws(const std::vector<std::pair<uint64_t, uint64_t>>& elements) {
+    try {
+        FrozenHashMap<uint64_t, uint64_t, Hash> frozen(elements.begin(), elements.end());
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+void bad_keys() {
+    std::vector<std::pair<uint64_t, uint64_t>> elements;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        elements.emplace_back(key, key);
+    }
+    CHECK(!build_throws<std::invalid_argument, std::hash<uint64_t>>(elements));
+    CHECK(build_throws<std::invalid_argument, CollidingHash>(elements));
+    elements.emplace_back(500, 0);
+    CHECK(build_throws<std::invalid_argument, std::hash<uint64_t>>(elements));
+}
+
+void empty() {
+    FrozenHashMap<uint64_t, uint64_t> frozen;
+    CHECK(frozen.empty() && frozen.find(1) == nullptr && frozen.begin() == frozen.end());
+    bool thrown = false;
+    try {
+        frozen.at(1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main() {
+    from_hashmap(1);
+    from_hashmap(100000);
+    bad_keys();
+    empty();
+    return 0;
+}
@@ -0,0 +1,136 @@
+/* Hash functions: StringHash gives one value for std::string, std::string_view and const char*,
+   every length of every branch of hash_bytes_with_state() reads all its bytes, seeds change the values,
+   IntegerHash spreads strided keys, and DefaultHash picks the function by the key type.
+   Build and run: make hash_functions_test && ./hash_functions_test */
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "../hash_functions.h"
+#include "check.h"
+
+enum class Color { RED, GREEN };
+
+static_assert(std::is_base_of<IntegerHash, DefaultHash<int>>::value);
+static_assert(std::is_base_of<IntegerHash, DefaultHash<uint64_t>>::value);
+static_assert(std::is_base_of<IntegerHash, DefaultHash<Color>>::value);
+static_assert(std::is_base_of<IntegerHash, DefaultHash<const char*>>::value);
+static_assert(std::is_base_of<StringHash, DefaultHash<std::string>>::value);
+static_assert(std::is_base_of<StringHash, DefaultHash<std::string_view>>::value);
+static_assert(std::is_base_of<StringHash, DefaultHash<std::pmr::string>>::value);
+static_assert(!std::is_base_of<IntegerHash, DefaultHash<double>>::value &&
+              !std::is_base_of<StringHash, DefaultHash<double>>::value);
+static_assert(std::is_same<StringHash::is_transparent, void>::value);
+
+void check_multiply() {
+    uint64_t a = ~uint64_t(0);
+    uint64_t b = ~uint64_t(0);
+    hash_multiply(a, b);
+    CHECK(a == 1 && b == ~uint64_t(0) - 1);
+    a = uint64_t(1) << 63;
+    b = 6;
+    hash_multiply(a, b);
+    CHECK(a == 0 && b == 3);
+    a = 0x123456789ull;
+    b = 0x1000ull;
+    hash_multiply(a, b);
+    CHECK(a == 0x123456789000ull && b == 0);
+    CHECK(multiply_high(~uint64_t(0), ~uint64_t(0)) == ~uint64_t(0) - 1);
+    CHECK(multiply_high(uint64_t(1) << 63, 1000) == 500 && multiply_high(12345, 1000) == 0);
+}
+
+// The three string types hash the same, through StringHash and DefaultHash, with and without a seed.
+void check_string_types() {
+    for (uint64_t seed : {uint64_t(0), uint64_t(42)}) {
+        StringHash hash(seed);
+        DefaultHash<std::string> default_hash(seed);
+        for (size_t length = 0; length < 100; ++length) {
+            std::string key(length, 'a');
+            for (size_t i = 0; i < length; ++i) {
+                key[i] = static_cast<char>('a' + (i * 7 + length) % 26);
+            }
+            std::string_view view = key;
+            const char* pointer = key.c_str();
+            CHECK(hash(key) == hash(view) && hash(key) == hash(pointer));
+            CHECK(default_hash(key) == hash(key) && default_hash(std::string(view)) == hash(pointer));
+            CHECK(DefaultHash<std::string_view>(seed)(view) == hash(key));
+            CHECK(hash(key) == hash_bytes(key.data(), key.size(), seed));
+        }
+    }
+}
+
+/* Every length from 0 to 64 (both cases of <= 16 bytes, 17..48 and > 48) and some longer ones:
+   prefixes of one buffer have different hashes, and changing any byte changes the hash. */
+void check_all_lengths() {
+    std::mt19937_64 rng(25);
+    std::string buffer(300, '\0');
+    for (char& c : buffer) {
+        c = static_cast<char>(rng());
+    }
+    std::set<uint64_t> prefixes;
+    std::set<uint64_t> zeros;
+    for (size_t length = 0; length <= 200; length += length < 64 ? 1 : 17) {
+        uint64_t hash = hash_bytes(buffer.data(), length);
+        CHECK(prefixes.insert(hash).second);
+        std::string zero(length, '\0');
+        CHECK(zeros.insert(hash_bytes(zero.data(), length)).second);
+        for (size_t position = 0; position < length; ++position) {
+            std::string changed = buffer.substr(0, length);
+            changed[position] ^= 1;
+            CHECK(hash_bytes(changed.data(), length) != hash);
+            changed[position] ^= static_cast<char>(0x81);
+            CHECK(hash_bytes(changed.data(), length) != hash);
+        }
+    }
+}
+
+// Different seeds give different values for strings, bytes and integers; the same seed the same values.
+void check_seeds() {
+    std::string key = "some key of a table";
+    CHECK(StringHash(1)(key) != StringHash(2)(key) && StringHash(1)(key) != StringHash()(key));
+    CHECK(StringHash(1)(key) == StringHash(1)(key));
+    for (size_t length : {size_t(0), size_t(3), size_t(8), size_t(16), size_t(40), size_t(100)}) {
+        std::string bytes(length, 'x');
+        CHECK(hash_bytes(bytes.data(), length, 1) != hash_bytes(bytes.data(), length, 2));
+    }
+    for (uint64_t value : {uint64_t(0), uint64_t(1), ~uint64_t(0)}) {
+        CHECK(IntegerHash(1)(value) != IntegerHash(2)(value) && IntegerHash(1)(value) != IntegerHash()(value));
+    }
+    CHECK(DefaultHash<double>(1)(2.5) != DefaultHash<double>(2)(2.5));
+    CHECK(SeededHash<uint64_t>()(7) == SeededHash<uint64_t>()(7));
+    CHECK(SeededHash<uint64_t>()(7) == IntegerHash(random_hash_seed())(uint64_t(7)));
+    CHECK(SeededHash<std::string>()(key) == StringHash(random_hash_seed())(key));
+}
+
+/* IntegerHash: no collisions on a range, strided keys use all low bits, enums and pointers hash
+   as their values, and other keys are std::hash mixed by hash_integer(). */
+void check_integers() {
+    IntegerHash hash;
+    std::set<size_t> values;
+    std::set<size_t> low_bits;
+    for (uint64_t key = 0; key < 100000; ++key) {
+        CHECK(values.insert(hash(key)).second);
+        low_bits.insert(hash(key * 1024) % 1024);
+    }
+    CHECK(low_bits.size() > 1000);
+    CHECK(hash(Color::GREEN) == hash(1) && hash(int64_t(-1)) == hash(~uint64_t(0)));
+    int object = 0;
+    CHECK(hash(&object) == hash(reinterpret_cast<uintptr_t>(&object)));
+    const char* text = "text";
+    CHECK(DefaultHash<const char*>()(text) == hash(reinterpret_cast<uintptr_t>(text)));
+    CHECK(DefaultHash<double>()(2.5) == hash_integer(std::hash<double>()(2.5)));
+}
+
+int main() {
+    check_multiply();
+    check_string_types();
+    check_all_lengths();
+    check_seeds();
+    check_integers();
+    return 0;
+}
@@ -0,0 +1,752 @@
+/* HashMap: operations against std::unordered_map, string keys, copies,
+   exception safety of insert() and operator[], and operations, shrinks, copies and moves
+   in the middle of an incremental rebuild, the hysteresis of the load factor policy,
+   find_many() against find(), serialize()/deserialize() round trips and corrupted streams,
+   emplace(), try_emplace() and insert_or_assign(), which must not touch their arguments for a present key,
+   heterogeneous lookups, which must not allocate a key, pmr::HashMap, which must allocate from its resource,
+   stats() against the cells seen through the bucket interface, and OperationCounters.
+   Build and run: make hashtable_test && ./hashtable_test */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../hashtable.h"
+#include "map_checks.h"
+
+// Number of calls of the global operator new, a std::string of a long key makes one.
+size_t num_of_allocations = 0;
+
+void* operator new(size_t size) {
+    num_of_allocations++;
+    void* pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+using Map = HashMap<uint64_t, uint64_t>;
+using Expected = std::unordered_map<uint64_t, uint64_t>;
+
+// Whether cells of an old table are still to be moved: stats() counts the cells of both tables.
+template<class Table>
+bool migrating(const Table& map) {
+    return map.stats().num_of_cells > map.bucket_count();
+}
+
+// Inserts keys from next on until a growth starts a migration.
+void insert_until_migration(Map& map, Expected& expected, uint64_t& next) {
+    while (!migrating(map)) {
+        map.insert({next, next});
+        expected.insert({next, next});
+        next++;
+    }
+}
+
+/* Random operations on an incremental table which grows, then shrinks: every operation made
+   while a migration is in progress is followed by a full check by find() and iteration. */
+void check_operations_during_migration() {
+    Map map;
+    map.set_incremental_rebuild(true);
+    Expected expected;
+    std::mt19937_64 rng(6);
+    size_t checked = 0;
+    for (int phase = 0; phase < 4; ++phase) {
+        // Even phases insert three times more often than they erase, odd ones the opposite.
+        bool growing = phase % 2 == 0;
+        for (size_t op = 0; op < 20000; ++op) {
+            uint64_t key = rng() % 4000;
+            uint64_t kind = rng() % 8;
+            if (kind < (growing ? 3u : 1u)) {
+                map.insert({key, op});
+                expected.insert({key, op});
+            } else if (kind < 4) {
+                map[key] = op;
+                expected[key] = op;
+            } else if (kind < (growing ? 5u : 7u)) {
+                map.erase(key);
+                expected.erase(key);
+            } else {
+                auto it = map.find(key);
+                CHECK((it == map.end()) == (expected.count(key) == 0));
+                CHECK(it == map.end() || it->second == expected[key]);
+            }
+            if (migrating(map)) {
+                check_same_elements(map, expected);
+                checked++;
+            }
+        }
+    }
+    CHECK(checked > 0);
+    check_same_elements(map, expected);
+}
+
+/* Erases below the shrink threshold right after a growth started: the shrink finishes
+   the growth first and loses no element. Erases move cells fast enough to finish the growth
+   before the threshold, so the last round raises the threshold above the size instead. */
+void check_shrink_during_growth() {
+    Map map;
+    map.set_incremental_rebuild(true);
+    Expected expected;
+    uint64_t next = 0;
+    for (int round = 0; round < 3; ++round) {
+        insert_until_migration(map, expected, next);
+        size_t grown = map.bucket_count();
+        size_t shrinks = map.stats().num_of_shrinks;
+        if (round == 2) {
+            LoadFactorPolicy policy;
+            policy.max_load_factor = 8;
+            policy.min_load_factor = 2;
+            map.set_load_factor_policy(policy);
+            CHECK(map.stats().num_of_shrinks == shrinks + 1);
+            CHECK(map.bucket_count() < grown);
+            check_same_elements(map, expected);
+        }
+        while (expected.size() > 3) {
+            uint64_t key = expected.begin()->first;
+            map.erase(key);
+            expected.erase(key);
+        }
+        CHECK(map.bucket_count() < grown);
+        check_same_elements(map, expected);
+        for (int i = 0; i < 2000; ++i) {
+            map.insert({next, next});
+            expected.insert({next, next});
+            next++;
+        }
+        check_same_elements(map, expected);
+    }
+}
+
+// Copies and moves of a table in the middle of a migration, both go on working independently.
+void check_copy_during_migration() {
+    Map map;
+    map.set_incremental_rebuild(true);
+    Expected expected;
+    uint64_t next = 0;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert({next, next});
+        expected.insert({next, next});
+        next++;
+    }
+    insert_until_migration(map, expected, next);
+
+    Map copy(map);
+    CHECK(copy.incremental_rebuild());
+    check_same_elements(copy, expected);
+    copy.erase(0);
+    CHECK(map.contains(0));
+
+    Map moved(std::move(map));
+    CHECK(migrating(moved));
+    check_same_elements(moved, expected);
+
+    Map assigned;
+    assigned = moved;
+    check_same_elements(assigned, expected);
+    Map move_assigned;
+    move_assigned = std::move(moved);
+    check_same_elements(move_assigned, expected);
+
+    Expected more = expected;
+    for (uint64_t key = next; key < next + 5000; ++key) {
+        move_assigned.insert({key, key});
+        more.insert({key, key});
+        assigned.erase(key - next);
+    }
+    check_same_elements(move_assigned, more);
+    CHECK(assigned.size() == (expected.size() > 5000 ? expected.size() - 5000 : 0));
+    for (const auto& element : assigned) {
+        CHECK(element.first >= 5000 && expected.count(element.first) == 1);
+    }
+}
+
+bool policy_rejected(float max_load_factor, float min_load_factor, float growth_factor, bool shrink) {
+    LoadFactorPolicy policy;
+    policy.max_load_factor = max_load_factor;
+    policy.min_load_factor = min_load_factor;
+    policy.growth_factor = growth_factor;
+    policy.shrink = shrink;
+    try {
+        policy.validate();
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+/* validate() rejects settings without the gap min * growth^2 <= max, and a table keeps its policy
+   when set_load_factor_policy() throws. */
+void check_policy_validation() {
+    CHECK(!policy_rejected(1.0f, 0.25f, 2.0f, true));
+    CHECK(policy_rejected(1.0f, 0.3f, 2.0f, true));
+    CHECK(policy_rejected(0.9f, 0.25f, 2.0f, true));
+    CHECK(policy_rejected(1.0f, 0.5f, 1.5f, true));
+    CHECK(!policy_rejected(1.0f, 0.3f, 2.0f, false));
+    CHECK(policy_rejected(0.0f, 0.0f, 2.0f, true));
+    CHECK(policy_rejected(1.0f, 0.1f, 1.0f, true));
+    CHECK(policy_rejected(1.0f, -0.1f, 2.0f, true));
+
+    Map map;
+    LoadFactorPolicy bad;
+    bad.min_load_factor = 0.5f;
+    bool thrown = false;
+    try {
+        map.set_load_factor_policy(bad);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown && map.load_factor_policy().min_load_factor == DefaultLoadFactor::MIN_LOAD_FACTOR);
+    // max_load_factor() lowers min_load_factor to keep the gap instead of throwing.
+    map.max_load_factor(0.5f);
+    CHECK(map.load_factor_policy().min_load_factor * 4 <= 0.5f);
+}
+
+/* Inserts and erases of one key right at the growth threshold, then right at the shrink threshold:
+   the table rebuilds once, not on every operation. */
+void check_no_thrash() {
+    for (bool incremental : {false, true}) {
+        Map map;
+        map.set_incremental_rebuild(incremental);
+        uint64_t next = 0;
+        size_t capacity = map.bucket_count();
+        while (map.bucket_count() == capacity) {
+            map.insert({next, next});
+            next++;
+        }
+        auto rebuilds = [&map] {
+            return map.stats().num_of_grows + map.stats().num_of_shrinks;
+        };
+        size_t before = rebuilds();
+        for (int i = 0; i < 1000; ++i) {
+            map.erase(next - 1);
+            map.insert({next - 1, 0});
+        }
+        CHECK(rebuilds() == before);
+        capacity = map.bucket_count();
+        while (map.bucket_count() == capacity) {
+            next--;
+            map.erase(next);
+        }
+        before = rebuilds();
+        for (int i = 0; i < 1000; ++i) {
+            map.insert({next, next});
+            map.erase(next);
+        }
+        CHECK(rebuilds() == before);
+        CHECK(map.size() == next);
+    }
+}
+
+/* find_many() gives the iterators of find() for hits and misses, for batches shorter and longer
+   than its pipeline, in a stable table and in the middle of a migration. */
+template<class Key, class MakeKey>
+void check_find_many(MakeKey make_key) {
+    using KeyMap = HashMap<Key, uint64_t>;
+    KeyMap map;
+    map.set_incremental_rebuild(true);
+    std::mt19937_64 rng(12);
+    auto check_batches = [&map, &rng, &make_key](uint64_t num_of_keys) {
+        for (size_t n : {size_t(0), size_t(1), size_t(7), size_t(33), size_t(1000)}) {
+            std::vector<Key> keys;
+            for (size_t i = 0; i < n; ++i) {
+                keys.push_back(make_key(rng() % (2 * num_of_keys + 1)));
+            }
+            std::vector<typename KeyMap::iterator> found(n);
+            CHECK(map.find_many(keys.data(), n, found.begin()) == found.end());
+            std::vector<typename KeyMap::const_iterator> const_found;
+            const KeyMap& const_map = map;
+            const_map.find_many(keys.data(), n, std::back_inserter(const_found));
+            CHECK(const_found.size() == n);
+            for (size_t i = 0; i < n; ++i) {
+                CHECK(found[i] == map.find(keys[i]));
+                CHECK(const_found[i] == const_map.find(keys[i]));
+            }
+        }
+    };
+    // Batches right after every growth, while it is still migrating, and in every stable table.
+    size_t checked_in_migration = 0;
+    size_t capacity = map.bucket_count();
+    for (uint64_t next = 0; next < 50000; ++next) {
+        map.insert({make_key(next), next});
+        if (map.bucket_count() != capacity) {
+            capacity = map.bucket_count();
+            for (uint64_t i = 0; i < 2 && migrating(map); ++i) {
+                check_batches(next + 1);
+                checked_in_migration++;
+            }
+        } else if (next % 5000 == 0) {
+            check_batches(next + 1);
+        }
+    }
+    CHECK(checked_in_migration > 0);
+}
+
+// Input stream over a string which, like a pipe, can't seek or tell its position.
+class PipeBuffer : public std::streambuf {
+  public:
+    explicit PipeBuffer(std::string data): data_(std::move(data)) {
+        setg(&data_[0], &data_[0], &data_[0] + data_.size());
+    }
+
+  private:
+    std::string data_;
+};
+
+template<class Table>
+std::string serialized(const Table& map) {
+    std::ostringstream out;
+    map.serialize(out);
+    return out.str();
+}
+
+// Whether deserialize() of data throws std::runtime_error; the table must not change then.
+template<class Table>
+bool load_fails(Table& map, const std::string& data) {
+    std::string before = serialized(map);
+    std::istringstream in(data);
+    try {
+        map.deserialize(in);
+    } catch (const std::runtime_error&) {
+        CHECK(serialized(map) == before);
+        return true;
+    }
+    return false;
+}
+
+/* Round trips of integer and string tables: the loaded table has the same elements, keeps its settings
+   and is rebuilt once when the stream tells its size, a few times when it does not. */
+void check_serialization_round_trip() {
+    // The last size is above DESERIALIZE_PRESIZE_LIMIT, so loading it from a pipe has to grow.
+    for (uint64_t size : {uint64_t(0), uint64_t(1), uint64_t(1300000)}) {
+        Map map;
+        Expected expected;
+        for (uint64_t key = 0; key < size; ++key) {
+            map.insert({key * 0x9E3779B97F4A7C15ull, key});
+            expected.insert({key * 0x9E3779B97F4A7C15ull, key});
+        }
+        std::string data = serialized(map);
+        Map loaded;
+        loaded.set_incremental_rebuild(true);
+        std::istringstream in(data + "tail");
+        loaded.deserialize(in);
+        check_same_elements(loaded, expected);
+        CHECK(loaded.incremental_rebuild());
+        CHECK(loaded.stats().num_of_grows == (size > 1 ? 1 : 0) && loaded.stats().num_of_shrinks == 0);
+        std::string tail;
+        in >> tail;
+        CHECK(tail == "tail");
+
+        PipeBuffer pipe(data);
+        std::istream pipe_in(&pipe);
+        Map from_pipe;
+        from_pipe.deserialize(pipe_in);
+        check_same_elements(from_pipe, expected);
+        CHECK(from_pipe.stats().num_of_grows <= 3);
+    }
+    HashMap<std::string, std::string> strings;
+    std::unordered_map<std::string, std::string> expected;
+    for (uint64_t i = 0; i < 20000; ++i) {
+        std::string key = "key-with-a-long-heap-allocated-name-" + std::to_string(i);
+        strings.insert({key, std::string(i % 100, 'v')});
+        expected.insert({key, std::string(i % 100, 'v')});
+    }
+    HashMap<std::string, std::string> loaded;
+    std::istringstream in(serialized(strings));
+    loaded.deserialize(in);
+    check_same_elements(loaded, expected);
+}
+
+/* Truncated streams, changed bytes in the header, a count of elements far above the stream,
+   repeated keys and data after the end are rejected by std::runtime_error. */
+void check_corrupted_streams() {
+    Map source;
+    for (uint64_t key = 0; key < 20000; ++key) {
+        source.insert({key, key});
+    }
+    std::string data = serialized(source);
+    Map map = {{1, 2}, {3, 4}};
+    for (size_t length = 0; length < data.size(); length += 1 + length / 3) {
+        CHECK(load_fails(map, data.substr(0, length)));
+    }
+    CHECK(load_fails(map, data.substr(0, data.size() - 1)));
+    // Bytes 0-7 are the length of the first chunk, then the magic, the version and the count.
+    for (size_t offset : {size_t(0), size_t(8), size_t(16), size_t(24)}) {
+        std::string corrupted = data;
+        corrupted[offset] ^= 1;
+        CHECK(load_fails(map, corrupted));
+    }
+    for (uint64_t count : {std::numeric_limits<uint64_t>::max(), uint64_t(1) << 40, uint64_t(20001)}) {
+        std::string corrupted = data;
+        std::memcpy(&corrupted[24], &count, sizeof(count));
+        CHECK(load_fails(map, corrupted));
+        PipeBuffer pipe(corrupted);
+        std::istream pipe_in(&pipe);
+        bool thrown = false;
+        try {
+            map.deserialize(pipe_in);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown && map.size() == 2);
+    }
+    // The first element (key 0 of the first cell) written again in place of the second one.
+    std::string repeated = data;
+    std::memcpy(&repeated[48], &repeated[32], 16);
+    CHECK(load_fails(map, repeated));
+    CHECK(!load_fails(map, data));
+    CHECK(map.size() == 20000);
+}
+
+// Value which remembers whether it was moved from.
+struct MovedFlag {
+    std::string value;
+    bool moved_from = false;
+
+    explicit MovedFlag(std::string value): value(std::move(value)) {}
+
+    MovedFlag(const MovedFlag& other) = default;
+
+    MovedFlag(MovedFlag&& other): value(std::move(other.value)) {
+        other.moved_from = true;
+    }
+
+    MovedFlag& operator=(const MovedFlag& other) = default;
+
+    MovedFlag& operator=(MovedFlag&& other) {
+        value = std::move(other.value);
+        other.moved_from = true;
+        return *this;
+    }
+};
+
+/* try_emplace() leaves its key and arguments as they are when the key is present and hashes the key once;
+   emplace() does not replace a present element; insert_or_assign() assigns; rvalue insert() moves. */
+void check_emplace() {
+    using Counted = HashMap<std::string, MovedFlag, DefaultHash<std::string>, std::equal_to<std::string>,
+                            std::allocator<std::pair<const std::string, MovedFlag>>, ModuloCapacity,
+                            DefaultLoadFactor, OperationCounters>;
+    Counted map;
+    const std::string long_key = "key-with-a-long-heap-allocated-name";
+    std::string key = long_key;
+    MovedFlag value("first");
+    map.operation_counters().reset();
+    auto inserted = map.try_emplace(std::move(key), std::move(value));
+    CHECK(inserted.second && inserted.first->second.value == "first" && value.moved_from);
+    CHECK(map.operation_counters().hashes == 1);
+
+    key = long_key;
+    MovedFlag second("second");
+    map.operation_counters().reset();
+    auto present = map.try_emplace(std::move(key), std::move(second));
+    CHECK(!present.second && present.first == inserted.first);
+    CHECK(key == long_key && !second.moved_from && second.value == "second");
+    CHECK(map.operation_counters().hashes == 1 && map.operation_counters().allocations == 0);
+    CHECK(!map.try_emplace(long_key, second).second && map.at(long_key).value == "first");
+
+    // emplace() constructs the element before it knows the key, and throws it away.
+    CHECK(!map.emplace(long_key, MovedFlag("third")).second && map.at(long_key).value == "first");
+    auto emplaced = map.emplace(std::piecewise_construct, std::forward_as_tuple("other"), std::forward_as_tuple("fourth"));
+    CHECK(emplaced.second && emplaced.first->first == "other" && map.at("other").value == "fourth");
+
+    MovedFlag assigned("assigned");
+    auto result = map.insert_or_assign(long_key, std::move(assigned));
+    CHECK(!result.second && result.first->second.value == "assigned" && assigned.moved_from);
+    result = map.insert_or_assign(std::string("new"), MovedFlag("new value"));
+    CHECK(result.second && map.at("new").value == "new value");
+
+    std::pair<const std::string, MovedFlag> element("moved", MovedFlag("moved value"));
+    CHECK(map.insert(std::move(element)).second && element.second.moved_from);
+    CHECK(map.at("moved").value == "moved value");
+    std::pair<const std::string, MovedFlag> repeated("moved", MovedFlag("again"));
+    CHECK(!map.insert(std::move(repeated)).second && !repeated.second.moved_from);
+    CHECK(map.size() == 4);
+}
+
+using TransparentMap = HashMap<std::string, uint64_t, StringHash, std::equal_to<>>;
+
+// at() of a const table gives a const value, by the key type and by a heterogeneous key.
+static_assert(std::is_same<decltype(std::declval<const Map&>().at(0)), const uint64_t&>::value);
+static_assert(std::is_same<decltype(std::declval<Map&>().at(0)), uint64_t&>::value);
+static_assert(std::is_same<decltype(std::declval<const TransparentMap&>().at(std::string_view())),
+                           const uint64_t&>::value);
+static_assert(std::is_same<decltype(std::declval<TransparentMap&>().at(std::string_view())), uint64_t&>::value);
+
+/* Lookups of a std::string table by std::string_view and const char* through StringHash and
+   std::equal_to<>: every overload finds the keys and none of them makes a std::string. */
+void check_heterogeneous_lookup() {
+    TransparentMap map;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        map.insert({"key-with-a-long-heap-allocated-name-" + std::to_string(i), i});
+    }
+    const auto& const_map = map;
+    std::string buffer = "key-with-a-long-heap-allocated-name-500 and more";
+    std::string_view present(buffer.data(), buffer.size() - 9);
+    const char* literal = "key-with-a-long-heap-allocated-name-7";
+    std::string_view absent = "key-with-a-long-heap-allocated-name-1000";
+    size_t allocations = num_of_allocations;
+    CHECK(map.find(present) != map.end() && map.find(present)->second == 500);
+    CHECK(const_map.find(literal) != const_map.end() && const_map.find(literal)->second == 7);
+    CHECK(map.find(absent) == map.end() && const_map.find(absent) == const_map.end());
+    CHECK(map.at(present) == 500 && const_map.at(literal) == 7);
+    CHECK(map.count(present) == 1 && map.count(absent) == 0);
+    CHECK(map.contains(literal) && !map.contains(absent));
+    map.erase(absent);
+    map.erase(literal);
+    CHECK(!map.contains(literal) && map.size() == 999);
+    CHECK(num_of_allocations == allocations);
+    bool thrown = false;
+    try {
+        map.at(absent);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// Memory resource which counts its allocations and the bytes not given back yet.
+class CountingResource : public std::pmr::memory_resource {
+  public:
+    size_t num_of_allocations = 0;
+    size_t outstanding_bytes = 0;
+
+  private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        num_of_allocations++;
+        outstanding_bytes += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        outstanding_bytes -= bytes;
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/* Nodes and cells of a pmr::HashMap come from its resource, not from operator new; copies and moves
+   to another resource take memory from that one, and everything is given back. */
+void check_pmr() {
+    using PmrMap = pmr::HashMap<uint64_t, uint64_t>;
+    using Allocator = PmrMap::allocator_type;
+    CountingResource resource;
+    CountingResource other_resource;
+    {
+        PmrMap map{Allocator(&resource)};
+        CHECK(map.get_allocator().resource() == &resource && resource.num_of_allocations > 0);
+        size_t allocations = num_of_allocations;
+        for (uint64_t key = 0; key < 10000; ++key) {
+            map.insert({key, key});
+        }
+        map.rehash(50000);
+        for (uint64_t key = 0; key < 5000; ++key) {
+            map.erase(key * 2);
+        }
+        CHECK(num_of_allocations == allocations);
+        Expected expected;
+        for (uint64_t key = 1; key < 10000; key += 2) {
+            expected.insert({key, key});
+        }
+        check_same_elements(map, expected);
+
+        PmrMap copy(map, Allocator(&other_resource));
+        CHECK(copy.get_allocator().resource() == &other_resource && other_resource.outstanding_bytes > 0);
+        check_same_elements(copy, expected);
+        PmrMap default_copy(map);
+        CHECK(default_copy.get_allocator().resource() == std::pmr::get_default_resource());
+
+        // Resources differ: elements are moved one by one into memory of other_resource.
+        size_t other_allocations = other_resource.num_of_allocations;
+        PmrMap moved(std::move(map), Allocator(&other_resource));
+        CHECK(other_resource.num_of_allocations > other_allocations);
+        check_same_elements(moved, expected);
+        // Same resource: nodes are taken over, elements stay where they are.
+        const uint64_t* element = &moved.at(1);
+        PmrMap taken(std::move(moved), Allocator(&other_resource));
+        CHECK(&taken.at(1) == element);
+        check_same_elements(taken, expected);
+        copy = taken;
+        CHECK(copy.get_allocator().resource() == &other_resource);
+        check_same_elements(copy, expected);
+    }
+    CHECK(resource.outstanding_bytes == 0 && other_resource.outstanding_bytes == 0);
+
+    // A monotonic buffer is thrown away with the map.
+    std::pmr::monotonic_buffer_resource buffer;
+    pmr::HashMap<uint64_t, uint64_t> map{Allocator(&buffer)};
+    for (uint64_t key = 0; key < 1000; ++key) {
+        map[key] = key;
+    }
+    CHECK(map.size() == 1000 && map.at(999) == 999);
+}
+
+// stats() agrees with bucket_count(), bucket_size() and size() of a table which is not migrating.
+template<class Table>
+void check_stats_shape(const Table& map) {
+    HashMapStats stats = map.stats();
+    CHECK(stats.size == map.size() && stats.num_of_cells == map.bucket_count());
+    std::vector<size_t> histogram;
+    for (size_t cell = 0; cell < map.bucket_count(); ++cell) {
+        size_t size = map.bucket_size(cell);
+        histogram.resize(std::max(histogram.size(), size + 1), 0);
+        histogram[size]++;
+    }
+    CHECK(stats.bucket_size_histogram == histogram);
+    CHECK(stats.max_bucket_size + 1 == histogram.size());
+    CHECK(std::abs(stats.empty_bucket_ratio - double(histogram[0]) / map.bucket_count()) < 1e-9);
+    size_t non_empty = map.bucket_count() - histogram[0];
+    CHECK(non_empty == 0 ? stats.average_bucket_size == 0 : stats.average_bucket_size == double(map.size()) / non_empty);
+    CHECK(stats.bucket_bytes >= map.bucket_count() * sizeof(typename Table::cell_type) +
+                                map.size() * sizeof(typename Table::entry));
+    CHECK(stats.node_bytes >= map.size() * sizeof(typename Table::value_type));
+}
+
+/* Shape of the cells, and grows and shrinks counted as the capacity changes; during a migration
+   the cells of both tables are counted. */
+void check_stats() {
+    Map map;
+    check_stats_shape(map);
+    CHECK(map.stats().num_of_grows == 0 && map.stats().num_of_shrinks == 0 && map.stats().rebuild_seconds == 0);
+    size_t grows = 0;
+    for (uint64_t key = 0; key < 100000; ++key) {
+        size_t capacity = map.bucket_count();
+        map.insert({key, key});
+        grows += map.bucket_count() > capacity ? 1 : 0;
+    }
+    check_stats_shape(map);
+    CHECK(map.stats().num_of_grows == grows && grows > 10 && map.stats().rebuild_seconds > 0);
+    size_t shrinks = 0;
+    for (uint64_t key = 0; key < 99000; ++key) {
+        size_t capacity = map.bucket_count();
+        map.erase(key);
+        shrinks += map.bucket_count() < capacity ? 1 : 0;
+    }
+    check_stats_shape(map);
+    CHECK(map.stats().num_of_shrinks == shrinks && shrinks > 0 && map.stats().num_of_grows == grows);
+    map.clear();
+    CHECK(map.stats().node_bytes == 0);
+
+    Map incremental;
+    incremental.set_incremental_rebuild(true);
+    Expected expected;
+    uint64_t next = 0;
+    insert_until_migration(incremental, expected, next);
+    HashMapStats stats = incremental.stats();
+    CHECK(stats.num_of_cells > incremental.bucket_count() && stats.size == incremental.size());
+    size_t counted = 0;
+    for (size_t size = 0; size < stats.bucket_size_histogram.size(); ++size) {
+        counted += size * stats.bucket_size_histogram[size];
+    }
+    CHECK(counted == incremental.size());
+}
+
+template<class Key, class Instrumentation>
+using InstrumentedMap = HashMap<Key, uint64_t, DefaultHash<Key>, std::equal_to<Key>,
+                                std::allocator<std::pair<const Key, uint64_t>>, ModuloCapacity,
+                                DefaultLoadFactor, Instrumentation>;
+
+// NoOperationCounters takes no space: the tables differ exactly by the counters.
+static_assert(sizeof(InstrumentedMap<uint64_t, NoOperationCounters>) + sizeof(OperationCounters) ==
+              sizeof(InstrumentedMap<uint64_t, OperationCounters>));
+
+/* Hashes, compares, probes and allocations of single operations, of rebuilds which hash integer
+   keys again and reuse the stored hashes of string keys, and of copies. */
+void check_operation_counters() {
+    InstrumentedMap<uint64_t, OperationCounters> map;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        map.insert({key, key});
+    }
+    CHECK(map.operation_counters().allocations == 1000 && map.operation_counters().hashes >= 1000);
+    OperationCounters& counters = map.operation_counters();
+    counters.reset();
+    CHECK(map.find(7) != map.end());
+    CHECK(counters.hashes == 1 && counters.compares >= 1 && counters.probes >= counters.compares);
+    CHECK(counters.allocations == 0);
+    counters.reset();
+    const auto& const_map = map;
+    CHECK(const_map.find(5000) == const_map.end() && counters.hashes == 1);
+    CHECK(counters.probes == const_map.bucket_size(const_map.bucket(5000)));
+    counters.reset();
+    map[5000] = 1;
+    CHECK(counters.hashes == 1 && counters.allocations == 1);
+    counters.reset();
+    map.rehash(4 * map.bucket_count());
+    CHECK(counters.hashes == map.size() && counters.allocations == 0 && counters.compares == 0);
+
+    InstrumentedMap<std::string, OperationCounters> strings;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        strings.insert({std::to_string(key), key});
+    }
+    strings.operation_counters().reset();
+    strings.rehash(4 * strings.bucket_count());
+    CHECK(strings.operation_counters().hashes == 0);
+    strings.operation_counters().reset();
+    CHECK(strings.count("500") == 1 && strings.operation_counters().compares == 1);
+
+    InstrumentedMap<uint64_t, OperationCounters> copy(map);
+    CHECK(copy.operation_counters().allocations == map.size());
+    OperationCounters merged;
+    merged.merge(copy.operation_counters());
+    merged.merge(copy.operation_counters());
+    CHECK(merged.allocations == 2 * map.size() && merged.hashes == 2 * copy.operation_counters().hashes);
+
+    InstrumentedMap<uint64_t, NoOperationCounters> plain;
+    plain.insert({1, 1});
+    CHECK(plain.find(1) != plain.end());
+}
+
+int main() {
+    check_random_operations<HashMap>(100, 20000);
+    check_random_operations<HashMap>(20000, 300000);
+    check_string_keys<HashMap>(20000);
+    check_copy_and_move<HashMap>();
+    check_key_arguments<HashMap>();
+    check_throwing_constructor<HashMap>(20000);
+    // Nodes are linked into the new cells by a rebuild, their values never move.
+    CHECK(check_throwing_move<HashMap, MoveOnlyThrowingValue>(20000) == 0);
+    check_operations_during_migration();
+    check_shrink_during_growth();
+    check_copy_during_migration();
+    check_policy_validation();
+    check_no_thrash();
+    check_find_many<uint64_t>([](uint64_t i) {
+        return i;
+    });
+    check_find_many<std::string>([](uint64_t i) {
+        return "key-" + std::to_string(i);
+    });
+    check_serialization_round_trip();
+    check_corrupted_streams();
+    check_emplace();
+    check_heterogeneous_lookup();
+    check_pmr();
+    check_stats();
+    check_operation_counters();
+    return 0;
+}
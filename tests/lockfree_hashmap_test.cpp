@@ -0,0 +1,161 @@
+/* LockFreeHashMap: results of one thread against std::unordered_map, a linearizability stress check
+   with several threads, and freeing of replaced nodes by EpochReclaimer.
+   Build and run: make lockfree_hashmap_test && ./lockfree_hashmap_test
+   Stress check: every key has one writer which assigns increasing versions and sometimes erases
+   the key, while readers remember the last version they saw of every key. A linearizable map
+   never shows a reader an older version after a newer one, and ends with the last version
+   of every key. Keys are few at first, so the check runs through many resizes. */
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../lockfree_hashmap.h"
+#include "check.h"
+
+// Value which counts its live copies.
+struct Counted {
+    static std::atomic<ptrdiff_t> live;
+
+    uint64_t value = 0;
+
+    Counted(uint64_t value): value(value) {
+        live++;
+    }
+
+    Counted(const Counted& other): value(other.value) {
+        live++;
+    }
+
+    ~Counted() {
+        live--;
+    }
+};
+
+std::atomic<ptrdiff_t> Counted::live{0};
+
+void single_thread() {
+    LockFreeHashMap<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    std::mt19937_64 rng(1);
+    for (uint64_t op = 0; op < 300000; ++op) {
+        uint64_t key = rng() % 20000;
+        switch (rng() % 4) {
+            case 0:
+                CHECK(map.insert({key, op}) == expected.insert({key, op}).second);
+                break;
+            case 1:
+                CHECK(map.insert_or_assign(key, op) == (expected.count(key) == 0));
+                expected[key] = op;
+                break;
+            case 2:
+                CHECK(map.erase(key) == (expected.erase(key) == 1));
+                break;
+            default:
+                auto found = map.find(key);
+                auto it = expected.find(key);
+                CHECK(found.has_value() == (it != expected.end()));
+                CHECK(!found || *found == it->second);
+        }
+    }
+    CHECK(map.size() == expected.size());
+    for (const auto& element : expected) {
+        CHECK(map.find(element.first) == element.second);
+    }
+}
+
+// Returns the number of violations.
+size_t stress_check(size_t num_of_writers, size_t num_of_readers, uint64_t num_of_keys, uint64_t num_of_rounds) {
+    LockFreeHashMap<uint64_t, uint64_t> map;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> violations{0};
+    std::vector<std::thread> writers;
+    for (size_t w = 0; w < num_of_writers; ++w) {
+        writers.emplace_back([&, w] {
+            for (uint64_t round = 1; round <= num_of_rounds; ++round) {
+                for (uint64_t key = w; key < num_of_keys; key += num_of_writers) {
+                    if (round % 5 == 0) {
+                        map.erase(key);
+                    } else {
+                        map.insert_or_assign(key, round);
+                    }
+                }
+            }
+        });
+    }
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < num_of_readers; ++r) {
+        readers.emplace_back([&] {
+            std::vector<uint64_t> last(num_of_keys, 0);
+            while (!stop.load()) {
+                for (uint64_t key = 0; key < num_of_keys; ++key) {
+                    auto version = map.find(key);
+                    if (version && *version < last[key]) {
+                        violations++;
+                    }
+                    if (version) {
+                        last[key] = *version;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    stop.store(true);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    uint64_t last_round = num_of_rounds % 5 == 0 ? num_of_rounds - 1 : num_of_rounds;
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        auto version = map.find(key);
+        if (num_of_rounds % 5 == 0 ? version.has_value() : (!version || *version != last_round)) {
+            violations++;
+        }
+    }
+    if (map.size() != (num_of_rounds % 5 == 0 ? 0 : num_of_keys)) {
+        violations++;
+    }
+    return violations.load();
+}
+
+/* Every assign replaces a node, the replaced ones must be freed while the map is in use,
+   not only at exit. Readers copy values at the same time, so a node freed too early
+   is a use after free under AddressSanitizer. */
+void reclamation() {
+    const uint64_t num_of_keys = 100;
+    const uint64_t num_of_assigns = 200000;
+    LockFreeHashMap<uint64_t, Counted> map;
+    std::atomic<bool> stop{false};
+    std::thread reader([&] {
+        while (!stop.load()) {
+            for (uint64_t key = 0; key < num_of_keys; ++key) {
+                auto value = map.find(key);
+                CHECK(!value || value->value % num_of_keys == key);
+            }
+        }
+    });
+    for (uint64_t i = 0; i < num_of_assigns; ++i) {
+        map.insert_or_assign(i % num_of_keys, Counted(i));
+    }
+    stop.store(true);
+    reader.join();
+    CHECK(map.size() == num_of_keys);
+    // Values of the map, plus the retired nodes of the last few epochs.
+    CHECK(Counted::live.load() < ptrdiff_t(num_of_assigns / 10));
+}
+
+int main() {
+    single_thread();
+    size_t violations = stress_check(4, 4, 5000, 41) + stress_check(2, 6, 500, 200);
+    if (violations != 0) {
+        std::fprintf(stderr, "stress check: %zu violations\n", violations);
+        return 1;
+    }
+    reclamation();
+    return 0;
+}
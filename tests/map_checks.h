@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "../hash_functions.h"
+#include "check.h"
+
+/* Checks shared by the tables with the interface of HashMap (insert, erase, find, operator[], at,
+   iteration, copy and move). Every check takes the table type as Map<KeyType, ValueType>. */
+
+// Same elements as expected, found both by find() and by iteration.
+template<class Map, class Expected>
+void check_same_elements(const Map& map, const Expected& expected) {
+    CHECK(map.size() == expected.size());
+    CHECK(map.empty() == expected.empty());
+    size_t iterated = 0;
+    for (const auto& element : map) {
+        auto it = expected.find(element.first);
+        CHECK(it != expected.end() && it->second == element.second);
+        iterated++;
+    }
+    CHECK(iterated == expected.size());
+    for (const auto& element : expected) {
+        auto it = map.find(element.first);
+        CHECK(it != map.end() && it->second == element.second);
+        CHECK(map.at(element.first) == element.second);
+    }
+}
+
+/* Random inserts, assignments by operator[] and erases against std::unordered_map.
+   Few keys, so erased slots are reused and the table rebuilds many times. */
+template<template<class, class> class Map>
+void check_random_operations(uint64_t num_of_keys, size_t num_of_ops) {
+    Map<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    std::mt19937_64 rng(num_of_keys);
+    for (size_t op = 0; op < num_of_ops; ++op) {
+        uint64_t key = rng() % num_of_keys;
+        switch (rng() % 4) {
+            case 0:
+                map.insert({key, op});
+                expected.insert({key, op});
+                break;
+            case 1:
+                map[key] = op;
+                expected[key] = op;
+                break;
+            case 2:
+                map.erase(key);
+                expected.erase(key);
+                break;
+            default:
+                auto it = map.find(key);
+                CHECK((it == map.end()) == (expected.count(key) == 0));
+                CHECK(it == map.end() || it->second == expected[key]);
+        }
+        CHECK(map.size() == expected.size());
+    }
+    check_same_elements(map, expected);
+    bool thrown = false;
+    try {
+        map.at(num_of_keys);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// Keys which own memory: moves of elements between slots must not lose or double them.
+template<template<class, class> class Map>
+void check_string_keys(size_t num_of_keys) {
+    Map<std::string, std::string> map;
+    std::unordered_map<std::string, std::string> expected;
+    for (size_t i = 0; i < num_of_keys; ++i) {
+        std::string key = "key-with-a-long-heap-allocated-name-" + std::to_string(i);
+        map.insert({key, std::to_string(i)});
+        expected.insert({key, std::to_string(i)});
+        if (i % 3 == 0) {
+            std::string erased = "key-with-a-long-heap-allocated-name-" + std::to_string(i / 2);
+            map.erase(erased);
+            expected.erase(erased);
+        }
+    }
+    check_same_elements(map, expected);
+}
+
+template<template<class, class> class Map>
+void check_copy_and_move() {
+    Map<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> expected;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        map.insert({key * 7, key});
+        expected.insert({key * 7, key});
+    }
+    Map<uint64_t, uint64_t> copy(map);
+    check_same_elements(copy, expected);
+    copy.erase(0);
+    CHECK(map.find(0) != map.end());
+    Map<uint64_t, uint64_t> moved(std::move(copy));
+    CHECK(moved.size() == expected.size() - 1);
+    copy = map;
+    check_same_elements(copy, expected);
+    map.clear();
+    CHECK(map.empty() && map.begin() == map.end());
+    map.insert({1, 2});
+    CHECK(map.size() == 1 && map.at(1) == 2);
+}
+
+/* The interface of HashMap: DefaultHash by default, keys taken by const reference
+   and moved into the table by operator[] of an rvalue. */
+template<template<class, class> class Map>
+void check_key_arguments() {
+    static_assert(std::is_same<decltype(Map<std::string, uint64_t>().hash_function()), DefaultHash<std::string>>::value);
+    static_assert(std::is_same<decltype(Map<uint64_t, uint64_t>().hash_function()), DefaultHash<uint64_t>>::value);
+    Map<std::string, uint64_t> map;
+    const std::string key = "key-with-a-long-heap-allocated-name";
+    map[key] = 1;
+    CHECK(map.find(key) != map.end() && map.at(key) == 1);
+    std::string moved = key + "-moved";
+    map[std::move(moved)] = 2;
+    CHECK(moved.empty() && map.at(key + "-moved") == 2);
+    std::string again = key + "-moved";
+    map[std::move(again)] = 3;
+    CHECK(again == key + "-moved" && map.at(again) == 3 && map.size() == 2);
+    map.erase(key);
+    CHECK(map.find(key) == map.end() && map.size() == 1);
+}
+
+// Value whose construction throws when countdown reaches zero.
+struct ThrowingValue {
+    static inline int countdown = 0;
+
+    uint64_t value = 0;
+
+    ThrowingValue() {
+        tick();
+    }
+
+    ThrowingValue(const ThrowingValue& other): value(other.value) {
+        tick();
+    }
+
+    ThrowingValue(ThrowingValue&&) = default;
+    ThrowingValue& operator=(const ThrowingValue&) = default;
+
+    static void tick() {
+        if (--countdown == 0) {
+            throw std::runtime_error("ThrowingValue");
+        }
+    }
+};
+
+/* An element whose constructor throws in insert() or operator[] is not in the table afterwards,
+   and size() and the other elements do not change. */
+template<template<class, class> class Map>
+void check_throwing_constructor(size_t num_of_keys) {
+    Map<uint64_t, ThrowingValue> map;
+    size_t thrown = 0;
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        ThrowingValue::countdown = 1 << 30;
+        ThrowingValue value;
+        value.value = key;
+        std::pair<const uint64_t, ThrowingValue> element(key, value);
+        size_t size = map.size();
+        // insert() copies the value of element into the table, operator[] default-constructs it.
+        ThrowingValue::countdown = key % 7 != 0 ? 1 << 30 : 1;
+        try {
+            if (key % 2 == 0) {
+                map.insert(element);
+            } else {
+                map[key] = value;
+            }
+        } catch (const std::runtime_error&) {
+            thrown++;
+            CHECK(map.size() == size);
+            CHECK(map.find(key) == map.end());
+        }
+    }
+    ThrowingValue::countdown = 1 << 30;
+    CHECK(thrown == (num_of_keys + 6) / 7);
+    size_t iterated = 0;
+    for (const auto& element : map) {
+        CHECK(element.first % 7 != 0);
+        iterated++;
+    }
+    CHECK(iterated == map.size());
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        CHECK((map.find(key) != map.end()) == (key % 7 != 0));
+    }
+}
+
+// Value whose move constructor throws when ThrowingValue::countdown reaches zero. It owns heap memory,
+// so an element which a table forgets to destroy is reported by LeakSanitizer.
+struct MoveOnlyThrowingValue {
+    std::unique_ptr<uint64_t> value;
+
+    MoveOnlyThrowingValue(): value(new uint64_t(0)) {}
+
+    MoveOnlyThrowingValue(MoveOnlyThrowingValue&& other) noexcept(false) {
+        ThrowingValue::tick();
+        value = std::move(other.value);
+    }
+};
+
+// The same with a copy constructor, which throws too.
+struct CopyableThrowingValue : MoveOnlyThrowingValue {
+    CopyableThrowingValue() = default;
+
+    CopyableThrowingValue(const CopyableThrowingValue& other) {
+        ThrowingValue::tick();
+        *value = *other.value;
+    }
+
+    CopyableThrowingValue(CopyableThrowingValue&&) = default;
+};
+
+/* Inserts by operator[] while the third element moved by a rebuild throws. A copyable value is copied
+   by the rebuild instead, and the table does not change; a move-only one loses the elements not moved
+   yet, but the table stays valid and destroys them. Returns the number of failed inserts. */
+template<template<class, class> class Map, class Value>
+size_t check_throwing_move(size_t num_of_keys) {
+    Map<uint64_t, Value> map;
+    size_t thrown = 0;
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        size_t size = map.size();
+        // An insert without a rebuild moves the new value at most once.
+        ThrowingValue::countdown = 3;
+        try {
+            *map[key].value = key;
+        } catch (const std::runtime_error&) {
+            ThrowingValue::countdown = 1 << 30;
+            thrown++;
+            CHECK(map.find(key) == map.end());
+            CHECK(!std::is_copy_constructible<Value>::value || map.size() == size);
+            size_t iterated = 0;
+            for (const auto& element : map) {
+                CHECK(*element.second.value == element.first);
+                CHECK(map.find(element.first) != map.end());
+                iterated++;
+            }
+            CHECK(iterated == map.size());
+            *map[key].value = key;
+        }
+    }
+    ThrowingValue::countdown = 1 << 30;
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        auto it = map.find(key);
+        CHECK(!std::is_copy_constructible<Value>::value || it != map.end());
+        CHECK(it == map.end() || *it->second.value == key);
+    }
+    return thrown;
+}
+
+// Hash which throws when ThrowingValue::countdown reaches zero.
+struct ThrowingHash {
+    size_t operator()(uint64_t key) const {
+        ThrowingValue::tick();
+        return std::hash<uint64_t>()(key);
+    }
+};
+
+/* Inserts while the third hash computed by a rebuild throws: the table keeps the elements moved
+   so far and destroys the others, and stays valid. Takes the table type as Map<KeyType, ValueType, Hash>.
+   Returns the number of failed inserts. */
+template<template<class, class, class> class Map>
+size_t check_throwing_hash(size_t num_of_keys) {
+    Map<uint64_t, std::string, ThrowingHash> map;
+    size_t thrown = 0;
+    for (uint64_t key = 0; key < num_of_keys; ++key) {
+        // An insert without a rebuild hashes its key once.
+        ThrowingValue::countdown = 3;
+        try {
+            map.insert({key, "value-with-a-long-heap-allocated-text-" + std::to_string(key)});
+        } catch (const std::runtime_error&) {
+            ThrowingValue::countdown = 1 << 30;
+            thrown++;
+            CHECK(map.find(key) == map.end());
+            size_t iterated = 0;
+            for (const auto& element : map) {
+                CHECK(element.second == "value-with-a-long-heap-allocated-text-" + std::to_string(element.first));
+                CHECK(map.find(element.first) != map.end());
+                iterated++;
+            }
+            CHECK(iterated == map.size());
+        }
+    }
+    ThrowingValue::countdown = 1 << 30;
+    return thrown;
+}
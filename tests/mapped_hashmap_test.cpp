@@ -0,0 +1,143 @@
+/* MappedHashMap: snapshots written by save_snapshot() find every key of the table and no other,
+   also when written in the middle of an incremental rebuild, and damaged files are rejected on open.
+   Build and run: make mapped_hashmap_test && ./mapped_hashmap_test */
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "../mapped_hashmap.h"
+#include "check.h"
+
+using Map = HashMap<uint64_t, uint64_t>;
+
+const char* const PATH = "mapped_hashmap_test.snapshot";
+
+std::string read_file(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const char* path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Every element of map is found in the snapshot with its value, and keys not in map are not.
+void check_same_elements(const MappedHashMap<uint64_t, uint64_t>& mapped, const Map& map, uint64_t num_of_keys) {
+    CHECK(mapped.size() == map.size());
+    CHECK(mapped.bucket_count() == map.bucket_count());
+    size_t iterated = 0;
+    for (const auto& record : mapped) {
+        CHECK(map.at(record.first) == record.second);
+        iterated++;
+    }
+    CHECK(iterated == map.size());
+    for (uint64_t key = 0; key < 2 * num_of_keys; ++key) {
+        const auto* record = mapped.find(key);
+        CHECK((record != nullptr) == map.contains(key));
+        CHECK(record == nullptr || (record->first == key && record->second == map.at(key)));
+    }
+}
+
+/* Even keys of [0; 2 * num_of_keys) and, for an incremental table, more of them until a growth
+   starts, so that the snapshot is written in the middle of its migration. */
+void round_trip(uint64_t num_of_keys, bool incremental) {
+    Map map;
+    map.set_incremental_rebuild(incremental);
+    uint64_t key = 0;
+    for (; key < 2 * num_of_keys; key += 2) {
+        map.insert({key, key * 3});
+    }
+    // stats() counts the cells of the old table too while they migrate.
+    while (incremental) {
+        size_t capacity = map.bucket_count();
+        map.insert({key, key * 3});
+        key += 2;
+        if (map.bucket_count() != capacity && map.stats().num_of_cells > map.bucket_count()) {
+            break;
+        }
+    }
+    num_of_keys = key / 2;
+    save_snapshot(map, PATH);
+    MappedHashMap<uint64_t, uint64_t> mapped(PATH);
+    check_same_elements(mapped, map, num_of_keys);
+    MappedHashMap<uint64_t, uint64_t> moved(std::move(mapped));
+    check_same_elements(moved, map, num_of_keys);
+    bool thrown = false;
+    try {
+        moved.at(1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+bool open_fails(const std::string& data) {
+    write_file(PATH, data);
+    try {
+        MappedHashMap<uint64_t, uint64_t> mapped(PATH);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Damaged headers, offsets and lengths are rejected on open, before any lookup reads the records.
+void corrupted_files() {
+    Map map;
+    for (uint64_t key = 0; key < 10000; ++key) {
+        map.insert({key, key});
+    }
+    save_snapshot(map, PATH);
+    std::string data = read_file(PATH);
+    CHECK(!open_fails(data));
+    SnapshotHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    CHECK(header.num_of_cells == map.bucket_count() && header.size == map.size());
+
+    for (size_t length : {size_t(0), sizeof(SnapshotHeader) - 1, sizeof(SnapshotHeader),
+                          static_cast<size_t>(header.records_offset), data.size() - 1}) {
+        CHECK(open_fails(data.substr(0, length)));
+    }
+    for (size_t field : {offsetof(SnapshotHeader, magic), offsetof(SnapshotHeader, version),
+                         offsetof(SnapshotHeader, record_size), offsetof(SnapshotHeader, num_of_cells),
+                         offsetof(SnapshotHeader, size), offsetof(SnapshotHeader, offsets_offset)}) {
+        std::string corrupted = data;
+        corrupted[field + 3] ^= 0x40;
+        CHECK(open_fails(corrupted));
+    }
+    // One word of the offsets in the middle: past the records, far past them, and past the next cell.
+    size_t middle = header.offsets_offset + header.num_of_cells / 2 * sizeof(uint64_t);
+    uint64_t offset = 0;
+    std::memcpy(&offset, &data[middle], sizeof(offset));
+    for (uint64_t value : {header.size + 1, uint64_t(1) << 60, offset + header.size / 2}) {
+        std::string corrupted = data;
+        std::memcpy(&corrupted[middle], &value, sizeof(value));
+        CHECK(open_fails(corrupted));
+    }
+    // The end of the last cell short of the number of records.
+    std::string corrupted = data;
+    uint64_t last = header.size - 1;
+    std::memcpy(&corrupted[header.offsets_offset + header.num_of_cells * sizeof(uint64_t)], &last, sizeof(last));
+    CHECK(open_fails(corrupted));
+    // Written with another hash: the first record does not match its key.
+    corrupted = data;
+    corrupted[header.records_offset] ^= 1;
+    CHECK(open_fails(corrupted));
+}
+
+int main() {
+    round_trip(0, false);
+    round_trip(1, false);
+    round_trip(100000, false);
+    round_trip(0, true);
+    round_trip(100000, true);
+    corrupted_files();
+    std::remove(PATH);
+    return 0;
+}
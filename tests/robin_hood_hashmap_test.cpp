@@ -0,0 +1,58 @@
+/* RobinHoodHashMap: operations against std::unordered_map, copies, exception safety
+   of insert() and operator[], and a degenerate hash which overflows MAX_DISTANCE.
+   Build and run: make robin_hood_hashmap_test && ./robin_hood_hashmap_test */
+#include <cstdint>
+#include <stdexcept>
+
+#include "../robin_hood_hashmap.h"
+#include "map_checks.h"
+
+// Every key has the same hash.
+struct ConstantHash {
+    size_t operator()(uint64_t) const {
+        return 42;
+    }
+};
+
+/* MAX_DISTANCE keys with one hash fit, the next one throws instead of growing the table
+   without end, and the table keeps its elements. */
+void check_degenerate_hash() {
+    using Map = RobinHoodHashMap<uint64_t, uint64_t, ConstantHash>;
+    Map map;
+    uint64_t key = 0;
+    bool thrown = false;
+    try {
+        for (; key <= Map::MAX_DISTANCE; ++key) {
+            map.insert({key, key});
+        }
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown && key == Map::MAX_DISTANCE);
+    CHECK(map.size() == Map::MAX_DISTANCE);
+    for (uint64_t k = 0; k < Map::MAX_DISTANCE; ++k) {
+        CHECK(map.find(k) != map.end() && map.find(k)->second == k);
+    }
+    thrown = false;
+    try {
+        map[Map::MAX_DISTANCE + 1] = 0;
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown && map.size() == Map::MAX_DISTANCE);
+    map.erase(0);
+    map.insert({Map::MAX_DISTANCE, 0});
+    CHECK(map.size() == Map::MAX_DISTANCE && map.find(Map::MAX_DISTANCE) != map.end());
+}
+
+int main() {
+    check_random_operations<RobinHoodHashMap>(100, 20000);
+    check_random_operations<RobinHoodHashMap>(20000, 300000);
+    check_string_keys<RobinHoodHashMap>(20000);
+    check_copy_and_move<RobinHoodHashMap>();
+    check_key_arguments<RobinHoodHashMap>();
+    check_throwing_constructor<RobinHoodHashMap>(20000);
+    CHECK(check_throwing_hash<RobinHoodHashMap>(20000) > 0);
+    check_degenerate_hash();
+    return 0;
+}
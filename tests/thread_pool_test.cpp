@@ -0,0 +1,232 @@
+/* Parallel passes of HashMap on a ThreadPool of four threads, whatever the number of cores:
+   bulk insert of ranges and parallel rebuilds give the tables of serial ones, and parallel scans
+   visit every element once, also when one chunk of cells is much slower than the others.
+   Run it under ThreadSanitizer too: make thread_pool_test CXXFLAGS="-std=c++17 -O1 -g -fsanitize=thread"
+   Build and run: make thread_pool_test && ./thread_pool_test */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../hashtable.h"
+#include "check.h"
+
+// Parallel passes run on four threads, serial ones on a pool of one thread.
+ThreadPool parallel_threads(4);
+ThreadPool serial_threads(1);
+
+/* Same elements, iterated in the same order: both tables have the same cells,
+   and the entries of every cell are in the same order. */
+template<class Map>
+void check_same_table(const Map& map, const Map& expected) {
+    CHECK(map.size() == expected.size());
+    CHECK(map.bucket_count() == expected.bucket_count());
+    auto it = expected.begin();
+    for (const auto& element : map) {
+        CHECK(it != expected.end() && element == *it);
+        ++it;
+    }
+    CHECK(it == expected.end());
+}
+
+/* insert(begin, end) of a range with repeated keys, into an empty and into a filled table,
+   from random access and from forward iterators: the first element of a key wins, as in a serial insert. */
+template<class Key, class MakeKey>
+void check_bulk_insert(MakeKey make_key) {
+    using Map = HashMap<Key, uint64_t>;
+    std::mt19937_64 rng(15);
+    std::vector<std::pair<Key, uint64_t>> elements;
+    for (uint64_t i = 0; i < 2 * Map::PARALLEL_BUILD_SIZE; ++i) {
+        elements.emplace_back(make_key(rng() % (3 * Map::PARALLEL_BUILD_SIZE / 2)), i);
+    }
+    std::list<std::pair<Key, uint64_t>> listed(elements.begin(), elements.end());
+    for (uint64_t filled : {uint64_t(0), uint64_t(1000)}) {
+        Map parallel;
+        parallel.set_thread_pool(&parallel_threads);
+        Map parallel_from_list;
+        parallel_from_list.set_thread_pool(&parallel_threads);
+        Map serial;
+        serial.set_thread_pool(&serial_threads);
+        for (uint64_t i = 0; i < filled; ++i) {
+            parallel.insert({make_key(i), 0});
+            parallel_from_list.insert({make_key(i), 0});
+            serial.insert({make_key(i), 0});
+        }
+        parallel.insert(elements.begin(), elements.end());
+        parallel_from_list.insert(listed.begin(), listed.end());
+        serial.insert(elements.begin(), elements.end());
+        for (uint64_t i = 0; i < filled; ++i) {
+            CHECK(parallel.at(make_key(i)) == 0);
+        }
+        check_same_table(parallel, serial);
+        check_same_table(parallel_from_list, serial);
+        Map copy(parallel);
+        CHECK(&copy.thread_pool() == &parallel_threads);
+    }
+}
+
+/* Growths by inserts, rehash() up and down and changes of the load factor policy of tables above PARALLEL_REBUILD_SIZE
+   with parallel rebuild: same cells and order of entries as the serial rebuild. Integer keys are
+   hashed again by the rebuild, string keys keep their hashes. */
+template<class Key, class MakeKey>
+void check_parallel_rebuild(MakeKey make_key) {
+    using Map = HashMap<Key, uint64_t>;
+    Map parallel;
+    parallel.set_thread_pool(&parallel_threads);
+    parallel.set_parallel_rebuild(true);
+    Map serial;
+    serial.set_thread_pool(&serial_threads);
+    serial.set_parallel_rebuild(true);
+    const uint64_t size = Map::PARALLEL_REBUILD_SIZE + Map::PARALLEL_REBUILD_SIZE / 2;
+    for (uint64_t i = 0; i < size; ++i) {
+        parallel.insert({make_key(i), i});
+        serial.insert({make_key(i), i});
+    }
+    CHECK(parallel.stats().num_of_grows == serial.stats().num_of_grows);
+    check_same_table(parallel, serial);
+    for (size_t cells : {4 * size, size / 2, size_t(0)}) {
+        parallel.rehash(cells);
+        serial.rehash(cells);
+        check_same_table(parallel, serial);
+    }
+    // A lower max load factor grows the table, then a higher min load factor shrinks it back.
+    for (float max_load_factor : {0.1f, 1.0f}) {
+        parallel.max_load_factor(max_load_factor);
+        serial.max_load_factor(max_load_factor);
+        check_same_table(parallel, serial);
+    }
+    LoadFactorPolicy policy;
+    policy.min_load_factor = 0.2f;
+    size_t grown = parallel.bucket_count();
+    parallel.set_load_factor_policy(policy);
+    serial.set_load_factor_policy(policy);
+    CHECK(parallel.bucket_count() < grown && parallel.size() >= Map::PARALLEL_REBUILD_SIZE);
+    check_same_table(parallel, serial);
+}
+
+/* parallel_for_each(), parallel_reduce() and parallel_count_if() against serial loops, on a stable table
+   and on an incremental table in the middle of a migration, where the old cells are scanned too. */
+void check_parallel_scans() {
+    using Map = HashMap<uint64_t, uint64_t>;
+    for (bool incremental : {false, true}) {
+        Map map;
+        map.set_thread_pool(&parallel_threads);
+        map.set_incremental_rebuild(incremental);
+        uint64_t key = 0;
+        for (; key < 100000; ++key) {
+            map.insert({key, key});
+        }
+        // Inserts until a growth, stats() counts the cells of the old table too while they migrate.
+        while (incremental) {
+            size_t capacity = map.bucket_count();
+            map.insert({key, key});
+            key++;
+            if (map.bucket_count() != capacity && map.stats().num_of_cells > map.bucket_count()) {
+                break;
+            }
+        }
+        map.parallel_for_each([](std::pair<const uint64_t, uint64_t>& element) {
+            element.second = element.second * 2 + 1;
+        });
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        size_t odd = 0;
+        for (const auto& element : map) {
+            CHECK(element.second == element.first * 2 + 1);
+            sum += element.second;
+            max = std::max(max, element.first);
+            odd += element.first % 2;
+        }
+        using Element = std::pair<const uint64_t, uint64_t>;
+        CHECK(map.parallel_reduce(uint64_t(0), [](const Element& element) {
+            return element.second;
+        }, std::plus<uint64_t>()) == sum);
+        CHECK(map.parallel_reduce(uint64_t(0), [](const Element& element) {
+            return element.first;
+        }, [](uint64_t a, uint64_t b) {
+            return std::max(a, b);
+        }) == max);
+        CHECK(map.parallel_count_if([](const Element& element) {
+            return element.first % 2 == 1;
+        }) == odd);
+        std::atomic<size_t> visited{0};
+        const Map& const_map = map;
+        const_map.parallel_for_each([&visited](const Element&) {
+            visited++;
+        });
+        CHECK(visited == map.size());
+        bool thrown = false;
+        try {
+            map.parallel_for_each([](Element& element) {
+                if (element.first == 777) {
+                    throw std::runtime_error("scan");
+                }
+            });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+/* The pool hands out chunks from a shared counter instead of stealing work: while the thread
+   of a slow chunk sleeps, the other threads take the other chunks, and the scan still visits
+   every element once. */
+void check_unbalanced_scan() {
+    using Map = HashMap<uint64_t, uint64_t>;
+    Map map;
+    map.set_thread_pool(&parallel_threads);
+    for (uint64_t key = 0; key < 100000; ++key) {
+        map.insert({key, 0});
+    }
+    CHECK(map.bucket_count() >= 8 * Map::PARALLEL_SCAN_CHUNK);
+    // Every chunk is run by one thread.
+    std::mutex mutex;
+    std::map<size_t, std::thread::id> thread_of_chunk;
+    map.parallel_for_each([&](std::pair<const uint64_t, uint64_t>& element) {
+        element.second++;
+        size_t chunk = map.bucket(element.first) / Map::PARALLEL_SCAN_CHUNK;
+        if (chunk == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        thread_of_chunk[chunk] = std::this_thread::get_id();
+    });
+    for (const auto& element : map) {
+        CHECK(element.second == 1);
+    }
+    size_t chunks_of_others = 0;
+    for (const auto& chunk : thread_of_chunk) {
+        chunks_of_others += chunk.second != thread_of_chunk[0] ? 1 : 0;
+    }
+    CHECK(chunks_of_others > 0);
+}
+
+int main() {
+    CHECK(parallel_threads.num_of_threads() == 4);
+    check_bulk_insert<uint64_t>([](uint64_t i) {
+        return i * 0x9E3779B97F4A7C15ull;
+    });
+    check_bulk_insert<std::string>([](uint64_t i) {
+        return "key-" + std::to_string(i);
+    });
+    check_parallel_rebuild<uint64_t>([](uint64_t i) {
+        return i * 0x9E3779B97F4A7C15ull;
+    });
+    check_parallel_rebuild<std::string>([](uint64_t i) {
+        return "key-" + std::to_string(i);
+    });
+    check_parallel_scans();
+    check_unbalanced_scan();
+    return 0;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads for data-parallel loops of the containers.
+   run(num_of_tasks, task) calls task(i) for every i on the workers and on the calling thread
+   and returns when all tasks are done. Jobs run one at a time; run() from inside a task,
+   or on a pool without workers, executes the tasks on the calling thread. */
+class ThreadPool {
+  public:
+    // Number of workers is num_of_threads - 1, the thread which calls run() is the last one.
+    explicit ThreadPool(size_t num_of_threads = std::thread::hardware_concurrency()) {
+        for (size_t i = 1; i < num_of_threads; ++i) {
+            workers_.emplace_back([this] {
+                worker_loop();
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // Pool shared by all containers, with a thread per hardware thread.
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t num_of_threads() const {
+        return workers_.size() + 1;
+    }
+
+    /* Calls task(i) for every i in [0; num_of_tasks), returns when all of them are done.
+       If tasks throw, the tasks which did not start yet are skipped and the first exception is rethrown. */
+    void run(size_t num_of_tasks, const std::function<void(size_t)>& task) {
+        if (workers_.empty() || num_of_tasks <= 1 || inside_task()) {
+            for (size_t i = 0; i < num_of_tasks; ++i) {
+                task(i);
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        Job job(task, num_of_tasks);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            generation_++;
+        }
+        wake_.notify_all();
+        work(job);
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_ = nullptr;
+        done_.wait(lock, [&job] {
+            return job.num_of_workers == 0;
+        });
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+
+  private:
+    struct Job {
+        Job(const std::function<void(size_t)>& task, size_t num_of_tasks): task(task), num_of_tasks(num_of_tasks) {}
+
+        const std::function<void(size_t)>& task;
+        size_t num_of_tasks;
+        std::atomic<size_t> next_task{0};
+        std::atomic<bool> failed{false};
+        // Guarded by mutex_.
+        std::exception_ptr error;
+        size_t num_of_workers = 0;
+    };
+
+    static bool& inside_task() {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    void work(Job& job) {
+        bool was_inside = inside_task();
+        inside_task() = true;
+        for (size_t i = job.next_task++; i < job.num_of_tasks; i = job.next_task++) {
+            if (job.failed.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            try {
+                job.task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!job.error) {
+                    job.error = std::current_exception();
+                }
+                job.failed.store(true);
+            }
+        }
+        inside_task() = was_inside;
+    }
+
+    void worker_loop() {
+        size_t last_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this, last_generation] {
+                return stop_ || (job_ != nullptr && generation_ != last_generation);
+            });
+            if (stop_) {
+                return;
+            }
+            Job* job = job_;
+            last_generation = generation_;
+            job->num_of_workers++;
+            lock.unlock();
+            work(*job);
+            lock.lock();
+            if (--job->num_of_workers == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+  private:
+    std::vector<std::thread> workers_;
+    // Serializes run() calls from different threads.
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Job* job_ = nullptr;
+    // Number of the current job, a worker joins every job once.
+    size_t generation_ = 0;
+    bool stop_ = false;
+};